@@ -3,17 +3,19 @@
 #include "rose.h"
 #include "typeTable.h"
 #include "attributes.h"
+#include "runStats.h"
 #include "sageUtils.h"
 #include "dwarf.h"
 #include <boost/foreach.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 
-size_t DwarfROSE::unnamed_count = 0;
+size_t DwarfROSE::type_cache_hits = 0;
+size_t DwarfROSE::type_cache_misses = 0;
 
-// Generate the SgType representing the type held in the offset attribute.
-// Requires that the offset attributes have been generated.
-SgType * DwarfROSE::typeFromAttribute(OffsetAttribute * attr, SgScopeStatement * scope) {
+// Generate the SgType representing the type held in the annotation.
+// Requires that the annotations have been generated.
+SgType * DwarfROSE::typeFromAnnotation(DieAnnotation * attr, SgScopeStatement * scope) {
     if(attr == NULL) {
         return SageBuilder::buildVoidType();
     } else {
@@ -21,12 +23,102 @@ SgType * DwarfROSE::typeFromAttribute(OffsetAttribute * attr, SgScopeStatement *
     }
 }
 
-// Convert a DWARF type node into an SgType
+// Names for unnamed constructs come from their offset in .debug_info, so
+// they are the same however many units were converted before, and in
+// whichever process.
+std::string DwarfROSE::unnamedName(const std::string & prefix, SgAsmDwarfConstruct * c) {
+    return prefix + boost::lexical_cast<std::string>(c->get_overall_offset()) + "_";
+}
+
+static SgType * convertTypeUncached(SgAsmDwarfConstruct * c, SgScopeStatement * scope);
+
+// True if c or a construct enclosing it was pruned, so it won't be
+// converted on its own.
+static bool insidePruned(SgAsmDwarfConstruct * c) {
+    for(SgNode * n = c; n != NULL; n = n->get_parent()) {
+        DieAnnotation * attr = DieAnnotation::get(n);
+        if(attr != NULL && attr->pruned) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Whether a class, structure or union DIE has its members.
+static bool hasBody(SgAsmDwarfConstruct * c) {
+    switch(c->variantT()) {
+        case V_SgAsmDwarfStructureType:
+            return isSgAsmDwarfStructureType(c)->get_body() != NULL;
+        case V_SgAsmDwarfUnionType:
+            return isSgAsmDwarfUnionType(c)->get_body() != NULL;
+        case V_SgAsmDwarfClassType:
+            return isSgAsmDwarfClassType(c)->get_body() != NULL;
+        default:
+            return false;
+    }
+}
+
+// The declaration convertType places for a record it meets before the
+// traversal does: a definition for the traversal to fill in if the DIE
+// has members, otherwise a declaration.
+static SgClassDeclaration * buildRecord(SgAsmDwarfConstruct * c, const std::string & name, SgScopeStatement * parentScope) {
+    SgClassDeclaration * decl = NULL;
+    if(c->variantT() == V_SgAsmDwarfStructureType) {
+        decl = SageBuilder::buildStructDeclaration(name);
+    } else if(c->variantT() == V_SgAsmDwarfUnionType) {
+        decl = SageUtils::buildUnionDeclaration(name);
+    } else {
+        decl = SageBuilder::buildClassDeclaration(name, parentScope);
+    }
+    if(!hasBody(c)) {
+        decl->set_forward(true);
+    }
+    SageInterface::setOneSourcePositionForTransformation(decl);
+    SageInterface::fixStatement(decl, parentScope);
+    return decl;
+}
+
+static SgClassDeclaration * buildForward(const std::string & name, SgClassDeclaration::class_types classType,
+        SgScopeStatement * parentScope) {
+    SgClassDeclaration * decl = SageBuilder::buildNondefiningClassDeclaration_nfi(SgName(name), classType, parentScope);
+    SageInterface::setOneSourcePositionForTransformation(decl);
+    SageInterface::fixStatement(decl, parentScope);
+    return decl;
+}
+
+// Convert a DWARF type node into an SgType. Each DIE is converted at most
+// once per scope; after that the memoized type is returned.
 SgType * DwarfROSE::convertType(SgAsmDwarfConstruct * c, SgScopeStatement * scope) {
     if(c == NULL) {
         return SageBuilder::buildVoidType();
     }
 
+    DieTable * table = DieTable::current();
+    if(table == NULL) {
+        return convertTypeUncached(c, scope);
+    }
+    SgType * type = table->types.find(scope, c->get_offset());
+    if(type == NULL) {
+        // With -undwarf:trace-types, the outermost conversions that take
+        // long get a span; the ones inside them are part of it.
+        UnitStats * stats = table->stats;
+        bool traced = stats != NULL && stats->typeSpanMinimum > 0;
+        uint64_t start = traced && stats->typeDepth++ == 0 ? RunStats::microseconds() : 0;
+        type = convertTypeUncached(c, scope);
+        if(traced && --stats->typeDepth == 0) {
+            uint64_t end = RunStats::microseconds();
+            if(end - start >= stats->typeSpanMinimum) {
+                stats->addSpan(c->get_name().empty() ? c->class_name() : c->get_name(), "type", start, end);
+            }
+        }
+        table->types.insert(scope, c->get_offset(), type);
+    }
+    return type;
+}
+
+static SgType * convertTypeUncached(SgAsmDwarfConstruct * c, SgScopeStatement * scope) {
+    using namespace DwarfROSE;
+
     switch(c->variantT()) {
         // BASE TYPES
         case V_SgAsmDwarfBaseType:
@@ -34,7 +126,7 @@ SgType * DwarfROSE::convertType(SgAsmDwarfConstruct * c, SgScopeStatement * scop
 
         // POINTERS
         case V_SgAsmDwarfPointerType: {
-            OffsetAttribute * attr = OffsetAttribute::get(c);
+            DieAnnotation * attr = DieAnnotation::get(c);
             SgType * pointedTo = NULL;
             if(attr == NULL) {
                 pointedTo = SageBuilder::buildVoidType();
@@ -46,7 +138,7 @@ SgType * DwarfROSE::convertType(SgAsmDwarfConstruct * c, SgScopeStatement * scop
                                            
         // REFERENCES
         case V_SgAsmDwarfReferenceType: {
-            OffsetAttribute * attr = OffsetAttribute::get(c);
+            DieAnnotation * attr = DieAnnotation::get(c);
             SgType * referredTo = NULL;
             if(attr == NULL) {
                 std::cerr << "WARNING: Reference doesn't refer to any type." << std::endl;
@@ -59,21 +151,23 @@ SgType * DwarfROSE::convertType(SgAsmDwarfConstruct * c, SgScopeStatement * scop
 
         // ENUMS
         case V_SgAsmDwarfEnumerationType: {
-            OffsetAttribute * attr = OffsetAttribute::get(c);
+            DieAnnotation * attr = DieAnnotation::get(c);
             ROSE_ASSERT(attr != NULL);
             SgEnumDeclaration * enumDecl = isSgEnumDeclaration(attr->node);
             if(enumDecl == NULL) {
                 enumDecl = convertEnum(isSgAsmDwarfEnumerationType(c), scope);
                 ROSE_ASSERT(enumDecl != NULL);
                 SageInterface::fixStatement(enumDecl, scope);
-                SageInterface::insertStatementAfterLastDeclaration(enumDecl, scope);
+                if(!attr->shared) {
+                    DieTable::current()->declarations.append(scope, enumDecl);
+                }
             }
             return SageUtils::buildEnumType(enumDecl);
         };
 
         // TYPEDEFS
         case V_SgAsmDwarfTypedef: {
-            OffsetAttribute * attr = OffsetAttribute::get(c);
+            DieAnnotation * attr = DieAnnotation::get(c);
             ROSE_ASSERT(attr != NULL);
             SgTypedefDeclaration * decl = isSgTypedefDeclaration(attr->node);
             if(decl == NULL) {
@@ -85,10 +179,12 @@ SgType * DwarfROSE::convertType(SgAsmDwarfConstruct * c, SgScopeStatement * scop
                 decl = convertTypedef(isSgAsmDwarfTypedef(c), parentScope);
                 decl->set_forward(true);
                 SageInterface::fixStatement(decl, parentScope);
-                if(parent == NULL) {
-                    SageInterface::prependStatement(decl, parentScope);
+                if(attr->shared) {
+                    // Already written out by an earlier compilation unit.
+                } else if(parent == NULL) {
+                    DieTable::current()->declarations.prepend(parentScope, decl);
                 } else {
-                    SageInterface::insertStatementBefore(parent, decl, parentScope);
+                    DieTable::current()->declarations.insertBefore(parentScope, parent, decl);
                 }
                 attr->node = decl;
                 return SageUtils::buildTypedefType(decl);
@@ -99,9 +195,9 @@ SgType * DwarfROSE::convertType(SgAsmDwarfConstruct * c, SgScopeStatement * scop
         
         // CONST
         case V_SgAsmDwarfConstType: {
-            OffsetAttribute * attr = OffsetAttribute::get(c);
+            DieAnnotation * attr = DieAnnotation::get(c);
             ROSE_ASSERT(attr != NULL);
-            SgType * baseType = typeFromAttribute(attr, scope);
+            SgType * baseType = typeFromAnnotation(attr, scope);
             if(isSgReferenceType(baseType)) {
                 // DWARF seems to wrap references in consts to indicate that what they
                 // refer to can't be changed, but we don't actually want to make a const
@@ -114,9 +210,9 @@ SgType * DwarfROSE::convertType(SgAsmDwarfConstruct * c, SgScopeStatement * scop
 
         // VOLATILE
         case V_SgAsmDwarfVolatileType: {
-            OffsetAttribute * attr = OffsetAttribute::get(c);
+            DieAnnotation * attr = DieAnnotation::get(c);
             ROSE_ASSERT(attr != NULL);
-            SgType * baseType = typeFromAttribute(attr, scope);
+            SgType * baseType = typeFromAnnotation(attr, scope);
             return SageBuilder::buildVolatileType(baseType);
         };
 
@@ -124,7 +220,7 @@ SgType * DwarfROSE::convertType(SgAsmDwarfConstruct * c, SgScopeStatement * scop
         case V_SgAsmDwarfClassType:
         case V_SgAsmDwarfStructureType:
         case V_SgAsmDwarfUnionType: {
-            OffsetAttribute * attr = OffsetAttribute::get(c);
+            DieAnnotation * attr = DieAnnotation::get(c);
             ROSE_ASSERT(attr != NULL);
             SgClassDeclaration * decl = isSgClassDeclaration(attr->node);
             if(decl == NULL) {
@@ -136,51 +232,61 @@ SgType * DwarfROSE::convertType(SgAsmDwarfConstruct * c, SgScopeStatement * scop
                 SgStatement * parent = isSgStatement(scope->get_parent());
                 SgScopeStatement * parentScope = parent == NULL ? scope : SageInterface::getScope(parent);
                 SgClassDeclaration::class_types classType = SgClassDeclaration::e_class;
-                SgClassDeclaration * newDecl = NULL;
                 std::string name = c->get_name();
                 if(c->variantT() == V_SgAsmDwarfStructureType) {
-                    classType = SgClassDeclaration::e_struct;    
+                    classType = SgClassDeclaration::e_struct;
                     if(name.empty()) {
-                        name = "_UNNAMED_STRUCT_" + boost::lexical_cast<std::string>(unnamed_count++);
-                    }
-                    newDecl = SageBuilder::buildStructDeclaration(name);
-                    if(isSgAsmDwarfStructureType(c)->get_body() == NULL) {
-                        newDecl->set_forward(true);
+                        name = unnamedName("_UNNAMED_STRUCT_", c);
                     }
                 } else if(c->variantT() == V_SgAsmDwarfUnionType) {
                     classType = SgClassDeclaration::e_union;
                     if(name.empty()) {
-                        name = "_UNNAMED_UNION_" + boost::lexical_cast<std::string>(unnamed_count++);
+                        name = unnamedName("_UNNAMED_UNION_", c);
                     }
-                    newDecl = SageUtils::buildUnionDeclaration(name);
-                    if(isSgAsmDwarfUnionType(c)->get_body() == NULL) {
-                        newDecl->set_forward(true);
-                    }
-                } else {
-                    if(name.empty()) {
-                        name = "_UNNAMED_CLASS_" + boost::lexical_cast<std::string>(unnamed_count++);
+                } else if(name.empty()) {
+                    name = unnamedName("_UNNAMED_CLASS_", c);
+                }
+
+                if(attr->shared) {
+                    // Already written out by an earlier compilation unit.
+                    SgClassDeclaration * forwardDecl = buildForward(name, classType, parentScope);
+                    attr->node = buildRecord(c, name, parentScope);
+                    return SageUtils::buildClassType(forwardDecl);
+                }
+
+                ForwardDeclarations::Record & record = DieTable::current()->forwards.lookup(parentScope, name);
+                ScopeQueue<SgScopeStatement, SgStatement> & declarations = DieTable::current()->declarations;
+                bool declared = record.forward != NULL;
+                if(!declared) {
+                    record.forward = buildForward(name, classType, parentScope);
+                }
+                if(insidePruned(c)) {
+                    // Left out of the output; declaring it is enough.
+                    attr->node = record.forward;
+                } else if(record.decl == NULL) {
+                    record.decl = buildRecord(c, name, parentScope);
+                    record.defined = hasBody(c);
+                    if(parent == NULL) {
+                        declarations.prepend(parentScope, record.decl);
+                    } else {
+                        declarations.insertBefore(parentScope, parent, record.decl);
                     }
-                    newDecl = SageBuilder::buildClassDeclaration(name, parentScope);
-                    if(isSgAsmDwarfClassType(c)->get_body() == NULL) {
-                        newDecl->set_forward(true);
+                    attr->node = record.decl;
+                } else if(!record.defined || !hasBody(c)) {
+                    // The same record seen through another DIE; a body
+                    // turns the placed declaration into the definition.
+                    if(hasBody(c)) {
+                        record.decl->set_forward(false);
+                        record.defined = true;
                     }
+                    attr->node = record.decl;
                 }
-                SgClassDeclaration * forwardDecl = SageBuilder::buildNondefiningClassDeclaration_nfi(SgName(name),
-                        classType, parentScope);
-                SageInterface::setOneSourcePositionForTransformation(forwardDecl);
-                SageInterface::fixStatement(forwardDecl, parentScope);
-                SageInterface::setOneSourcePositionForTransformation(newDecl);
-                SageInterface::fixStatement(newDecl, parentScope);
-                if(parent == NULL) {
-                    SageInterface::prependStatement(newDecl, parentScope);
-                } else {
-                    SageInterface::insertStatementBefore(parent, newDecl, parentScope);
+                // A second definition is left to the traversal, which
+                // converts it where it stands.
+                if(!declared) {
+                    declarations.prepend(parentScope, record.forward);
                 }
-                attr->node = newDecl;
-
-
-                SageInterface::prependStatement(forwardDecl, parentScope);
-                return SageUtils::buildClassType(forwardDecl);
+                return SageUtils::buildClassType(record.forward);
             } else {
                 return SageUtils::buildClassType(decl);
             }
@@ -189,9 +295,9 @@ SgType * DwarfROSE::convertType(SgAsmDwarfConstruct * c, SgScopeStatement * scop
         // ARRAYS
         case V_SgAsmDwarfArrayType: {
             SgAsmDwarfArrayType * arrayType = isSgAsmDwarfArrayType(c);
-            OffsetAttribute * attr = OffsetAttribute::get(c);
+            DieAnnotation * attr = DieAnnotation::get(c);
             ROSE_ASSERT(attr != NULL);
-            SgType * baseType = typeFromAttribute(attr, scope);
+            SgType * baseType = typeFromAnnotation(attr, scope);
             Rose_STL_Container<SgNode*> subranges = NodeQuery::querySubTree(arrayType, V_SgAsmDwarfSubrangeType);
             SgAsmDwarfSubrangeType * subrange = isSgAsmDwarfSubrangeType(subranges[0]);
             ROSE_ASSERT(subrange != NULL);
@@ -204,8 +310,8 @@ SgType * DwarfROSE::convertType(SgAsmDwarfConstruct * c, SgScopeStatement * scop
         // FUNCTION POINTERS
         case V_SgAsmDwarfSubroutineType: {
             std::string name = c->get_name();
-            OffsetAttribute * attr = OffsetAttribute::get(c);
-            SgType * retType = typeFromAttribute(attr, scope);
+            DieAnnotation * attr = DieAnnotation::get(c);
+            SgType * retType = typeFromAnnotation(attr, scope);
 
             SgFunctionParameterList * paramList = SageUtils::buildEmptyParameterList();
 
@@ -213,8 +319,8 @@ SgType * DwarfROSE::convertType(SgAsmDwarfConstruct * c, SgScopeStatement * scop
             BOOST_FOREACH(SgNode * n, formalParams) {
                 SgAsmDwarfFormalParameter * formalParam = isSgAsmDwarfFormalParameter(n);
                 std::string paramName = formalParam->get_name();
-                OffsetAttribute * paramAttr = OffsetAttribute::get(formalParam);
-                SgType * paramType = typeFromAttribute(paramAttr, scope);
+                DieAnnotation * paramAttr = DieAnnotation::get(formalParam);
+                SgType * paramType = typeFromAnnotation(paramAttr, scope);
                 SgInitializedName * initName = SageBuilder::buildInitializedName(paramName, paramType);
                 SageInterface::appendArg(paramList, initName);
             }
@@ -232,7 +338,7 @@ SgType * DwarfROSE::convertType(SgAsmDwarfConstruct * c, SgScopeStatement * scop
 
             // ROSE requires that a function declaration have a name.
             if(name.empty()) {
-                name = "_FUNCTION_POINTER_" + boost::lexical_cast<std::string>(unnamed_count++);
+                name = unnamedName("_FUNCTION_POINTER_", c);
             }
             // Build a function declaration to be the parameter list's parent (AST tests fail otherwise.)
             SgFunctionDeclaration * decl = SageBuilder::buildNondefiningFunctionDeclaration(SgName(name), retType, paramList);
@@ -244,25 +350,25 @@ SgType * DwarfROSE::convertType(SgAsmDwarfConstruct * c, SgScopeStatement * scop
 
         // UPC RELAXED
         case V_SgAsmDwarfUpcRelaxedType: {
-            OffsetAttribute * attr = OffsetAttribute::get(c);
+            DieAnnotation * attr = DieAnnotation::get(c);
             ROSE_ASSERT(attr != NULL);
-            SgType * baseType = typeFromAttribute(attr, scope);
+            SgType * baseType = typeFromAnnotation(attr, scope);
             return SageBuilder::buildUpcRelaxedType(baseType);
         };
         
         // UPC STRICT
         case V_SgAsmDwarfUpcStrictType: {
-            OffsetAttribute * attr = OffsetAttribute::get(c);
+            DieAnnotation * attr = DieAnnotation::get(c);
             ROSE_ASSERT(attr != NULL);
-            SgType * baseType = typeFromAttribute(attr, scope);
+            SgType * baseType = typeFromAnnotation(attr, scope);
             return SageBuilder::buildUpcStrictType(baseType);
         };
 
         // UPC SHARED
         case V_SgAsmDwarfUpcSharedType: {
-            OffsetAttribute * attr = OffsetAttribute::get(c);
+            DieAnnotation * attr = DieAnnotation::get(c);
             ROSE_ASSERT(attr != NULL);
-            SgType * baseType = typeFromAttribute(attr, scope);
+            SgType * baseType = typeFromAnnotation(attr, scope);
             return SageBuilder::buildUpcSharedType(baseType);
         };
 
@@ -282,7 +388,7 @@ SgFunctionDeclaration * DwarfROSE::convertSubprogram(SgAsmDwarfSubprogram * s, S
     
     std::string name = s->get_name();
     if(name.empty()) {
-        //name = "_UNNAMED_FUNCTION_" + boost::lexical_cast<std::string>(unnamed_count++) + "_";
+        //name = unnamedName("_UNNAMED_FUNCTION_", s);
         return NULL;
     }
 
@@ -322,12 +428,12 @@ SgFunctionDeclaration * DwarfROSE::convertSubprogram(SgAsmDwarfSubprogram * s, S
     }
 
     // Determine return type
-    OffsetAttribute * attr = OffsetAttribute::get(s);
+    DieAnnotation * attr = DieAnnotation::get(s);
     SgType * retType = NULL;
     if(isConstructor || isDestructor) {
         retType = SgTypeDefault::createType();
     } else {
-        retType = typeFromAttribute(attr, scope);
+        retType = typeFromAnnotation(attr, scope);
     }
 
     SgFunctionParameterList * paramList = SageUtils::buildEmptyParameterList();
@@ -341,8 +447,8 @@ SgFunctionDeclaration * DwarfROSE::convertSubprogram(SgAsmDwarfSubprogram * s, S
             SgAsmDwarfFormalParameter * formalParam = isSgAsmDwarfFormalParameter(n);
             if(formalParam != NULL && !formalParam->get_artificiality()) {
                 std::string paramName = formalParam->get_name();
-                OffsetAttribute * paramAttr = OffsetAttribute::get(formalParam);
-                SgType * paramType = typeFromAttribute(paramAttr, scope);
+                DieAnnotation * paramAttr = DieAnnotation::get(formalParam);
+                SgType * paramType = typeFromAnnotation(paramAttr, scope);
                 SgInitializedName * initName = SageBuilder::buildInitializedName(paramName, paramType);
                 SageInterface::appendArg(paramList, initName);
             }
@@ -400,7 +506,7 @@ SgEnumDeclaration * DwarfROSE::convertEnum(SgAsmDwarfEnumerationType * e, SgScop
     }
     std::string name = e->get_name();
     if(name.empty()) {
-        name = "_UNNAMED_ENUM_" + boost::lexical_cast<std::string>(unnamed_count++) + "_";
+        name = unnamedName("_UNNAMED_ENUM_", e);
     }
     SgEnumDeclaration * decl = SageBuilder::buildEnumDeclaration(SgName(name), scope);
     Rose_STL_Container<SgNode*> enumerators = NodeQuery::querySubTree(e, V_SgAsmDwarfEnumerator);
@@ -413,7 +519,7 @@ SgEnumDeclaration * DwarfROSE::convertEnum(SgAsmDwarfEnumerationType * e, SgScop
         decl->append_enumerator(init);
         init->set_parent(decl);
     }
-    OffsetAttribute::get(e)->node = decl;
+    DieAnnotation::get(e)->node = decl;
     return decl;
 }
 
@@ -421,9 +527,9 @@ SgTypedefDeclaration * DwarfROSE::convertTypedef(SgAsmDwarfTypedef * t, SgScopeS
     if(t == NULL) {
         return NULL;
     }               
-    OffsetAttribute * attr = OffsetAttribute::get(t);
+    DieAnnotation * attr = DieAnnotation::get(t);
     ROSE_ASSERT(attr != NULL);
-    SgType * baseType = typeFromAttribute(attr, scope);
+    SgType * baseType = typeFromAnnotation(attr, scope);
     std::string name = t->get_name();
     // ROSE insists that this have a scope when built; I don't know why.
     SgTypedefDeclaration * decl = SageBuilder::buildTypedefDeclaration(SgName(name), baseType, scope);
@@ -436,11 +542,11 @@ SgClassDeclaration * DwarfROSE::convertStruct(SgAsmDwarfStructureType * s, SgSco
         return NULL;
     }
 
-    OffsetAttribute * attr = OffsetAttribute::get(s);
+    DieAnnotation * attr = DieAnnotation::get(s);
     ROSE_ASSERT(attr != NULL);
     std::string name = s->get_name();
     if(name.empty()) {
-        name = "_UNNAMED_STRUCT_" + boost::lexical_cast<std::string>(unnamed_count++) + "_";
+        name = unnamedName("_UNNAMED_STRUCT_", s);
     }
     SgClassDeclaration * decl = SageBuilder::buildStructDeclaration(SgName(name));
     ROSE_ASSERT(decl != NULL);
@@ -456,11 +562,11 @@ SgClassDeclaration * DwarfROSE::convertUnion(SgAsmDwarfUnionType * s, SgScopeSta
         return NULL;
     }
 
-    OffsetAttribute * attr = OffsetAttribute::get(s);
+    DieAnnotation * attr = DieAnnotation::get(s);
     ROSE_ASSERT(attr != NULL);
     std::string name = s->get_name();
     if(name.empty()) {
-        name = "_UNNAMED_UNION_" + boost::lexical_cast<std::string>(unnamed_count++) + "_";
+        name = unnamedName("_UNNAMED_UNION_", s);
     }
     SgClassDeclaration * decl = SageUtils::buildUnionDeclaration(SgName(name));
     ROSE_ASSERT(decl != NULL);
@@ -476,10 +582,10 @@ SgVariableDeclaration * DwarfROSE::convertMember(SgAsmDwarfMember * m, SgScopeSt
         return NULL;
     }
 
-    OffsetAttribute * attr = OffsetAttribute::get(m);
+    DieAnnotation * attr = DieAnnotation::get(m);
     ROSE_ASSERT(attr != NULL);
     std::string name = m->get_name();
-    SgType * type = typeFromAttribute(attr, scope);
+    SgType * type = typeFromAnnotation(attr, scope);
     SgVariableDeclaration * decl = SageBuilder::buildVariableDeclaration(SgName(name), type);
     uint64_t bitfield = m->get_bit_size();
     if(bitfield > 0) {
@@ -505,12 +611,12 @@ SgBaseClass * DwarfROSE::convertInheritance(SgAsmDwarfInheritance * i, SgScopeSt
         return NULL;
     }
 
-    OffsetAttribute * attr = OffsetAttribute::get(i);
+    DieAnnotation * attr = DieAnnotation::get(i);
     ROSE_ASSERT(attr != NULL);
     if(attr->type == NULL) {
         std::cerr << "WARNING: Inheritance had no type." << std::endl;
     } else {
-        OffsetAttribute * typeAttr = OffsetAttribute::get(attr->type);
+        DieAnnotation * typeAttr = DieAnnotation::get(attr->type);
         ROSE_ASSERT(typeAttr != NULL);
         if(typeAttr->node == NULL) {
             convertType(attr->type, scope);
@@ -550,11 +656,11 @@ SgClassDeclaration * DwarfROSE::convertClass(SgAsmDwarfClassType * s, SgScopeSta
         return NULL;
     }
 
-    OffsetAttribute * attr = OffsetAttribute::get(s);
+    DieAnnotation * attr = DieAnnotation::get(s);
     ROSE_ASSERT(attr != NULL);
     SgClassDeclaration * decl = NULL;
     if(attr->spec != NULL) {
-        OffsetAttribute * specAttr = OffsetAttribute::get(attr->spec);
+        DieAnnotation * specAttr = DieAnnotation::get(attr->spec);
         if(specAttr != NULL && specAttr->node != NULL && isSgClassDeclaration(specAttr->node)) {
             SgClassDeclaration * nondefDecl = isSgClassDeclaration(specAttr->node);
             std::string qName = nondefDecl->get_qualified_name().getString();
@@ -575,7 +681,7 @@ SgClassDeclaration * DwarfROSE::convertClass(SgAsmDwarfClassType * s, SgScopeSta
             }
         }
         if(name.empty()) {
-            name = "_UNNAMED_CLASS_" + boost::lexical_cast<std::string>(unnamed_count++) + "_";
+            name = unnamedName("_UNNAMED_CLASS_", s);
         }
         decl = SageBuilder::buildClassDeclaration(SgName(name), scope);
         ROSE_ASSERT(decl != NULL);
@@ -593,12 +699,12 @@ SgNamespaceDeclarationStatement * DwarfROSE::convertNamespace(SgAsmDwarfNamespac
         return NULL;
     }
 
-    OffsetAttribute * attr = OffsetAttribute::get(s);
+    DieAnnotation * attr = DieAnnotation::get(s);
     ROSE_ASSERT(attr != NULL);
     std::string name = s->get_name();
     bool unnamed = false;
     if(name.empty()) {
-        name = "_UNNAMED_NAMESPACE_" + boost::lexical_cast<std::string>(unnamed_count++) + "_";
+        name = unnamedName("_UNNAMED_NAMESPACE_", s);
         unnamed = true;
     }
     SgNamespaceDeclarationStatement * decl = SageBuilder::buildNamespaceDeclaration_nfi(SgName(name), unnamed, scope);
@@ -3,13 +3,17 @@
 
 #include "rose.h"
 
-class OffsetAttribute;
+struct DieAnnotation;
 
 namespace DwarfROSE {
 
-    extern size_t unnamed_count;
+    // A name for a construct that has none, unique within the binary.
+    std::string unnamedName(const std::string & prefix, SgAsmDwarfConstruct * c);
+    // How often convertType found a DIE already converted in the same scope.
+    extern size_t type_cache_hits;
+    extern size_t type_cache_misses;
     SgFunctionParameterList * buildEmptyParameterList();
-    SgType * typeFromAttribute(OffsetAttribute * a, SgScopeStatement * s);
+    SgType * typeFromAnnotation(DieAnnotation * a, SgScopeStatement * s);
     SgType * convertType(SgAsmDwarfConstruct * c, SgScopeStatement * s);    
     SgFunctionDeclaration * convertSubprogram(SgAsmDwarfSubprogram * p, SgScopeStatement * s);
     SgEnumDeclaration * convertEnum(SgAsmDwarfEnumerationType * e, SgScopeStatement * s);
@@ -2,4 +2,4 @@
 #include <string>
 #include "attributes.h"
 
-const std::string OffsetAttribute::OFFSET_ATTRIBUTE = "OFFSET_ATTRIBUTE";
+DieTable * DieTable::currentTable = NULL;
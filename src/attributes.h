@@ -2,36 +2,103 @@
 #define __ATTRIBUTES_H__
 
 #include "rose.h"
+#include "dieIndex.h"
+#include "typeMemo.h"
+#include "scopeQueue.h"
+#include "forwardDeclarations.h"
 
+struct UnitStats;
 
-class OffsetAttribute : public AstAttribute {
+// What we know about one DWARF construct: the constructs its type and
+// specification references resolve to, and the node generated for it.
+// A shared construct is part of a type definition that an earlier
+// compilation unit already wrote out; it is converted so that it can be
+// referred to by name, but its declarations aren't emitted again.
+// A pruned construct isn't needed by anything the output is restricted
+// to, and neither it nor anything below it is converted.
+struct DieAnnotation {
+    SgAsmDwarfConstruct * construct;
+    SgAsmDwarfConstruct * type;
+    SgNode * node;
+    SgAsmDwarfConstruct * spec;
+    bool shared;
+    bool pruned;
+
+    DieAnnotation(SgAsmDwarfConstruct * c = NULL) : construct(c), type(NULL), node(NULL), spec(NULL), shared(false), pruned(false) {};
+
+    // The annotation for a construct in the current table, or NULL.
+    static inline DieAnnotation * get(SgNode * n);
+};
+
+// Dense, per-compilation-unit store of DieAnnotations. Each construct is
+// given a compact id in the order it was added, the annotations live in
+// one contiguous array indexed by that id, and the constructs' offsets
+// map to their ids. Dropping the table frees every annotation at once.
+//
+// Annotations must all be added before any pointer to one is handed
+// out, since adding may move the array.
+//
+// The table also carries the unit's memo of converted types, the
+// declarations waiting to be attached to their scopes and the forward
+// declarations made so far.
+class DieTable {
     public:
-        SgAsmDwarfConstruct * type;
-        SgNode * node;
-        SgAsmDwarfConstruct * spec;
-
-        OffsetAttribute(SgAsmDwarfConstruct * t = NULL, SgNode * n = NULL, SgAsmDwarfConstruct * s = NULL) 
-            : type(t), node(n), spec(s) {};
-        
-        static const std::string OFFSET_ATTRIBUTE;
-
-        static inline OffsetAttribute * get(SgNode * n) {
-           AstAttribute * attr = n->getAttribute(OFFSET_ATTRIBUTE);        
-           return dynamic_cast<OffsetAttribute*>(attr);
+        TypeMemo types;
+        ScopeQueue<SgScopeStatement, SgStatement> declarations;
+        ForwardDeclarations forwards;
+        // Where the conversion is timed, if it is
+        UnitStats * stats;
+
+        explicit DieTable(size_t expected = 0) : stats(NULL), ids(expected) {
+            entries.reserve(expected);
+        };
+
+        uint32_t add(SgAsmDwarfConstruct * c) {
+            uint32_t id = entries.size();
+            entries.push_back(DieAnnotation(c));
+            ids.insert(c->get_offset(), id);
+            return id;
         };
 
-        inline void add(SgNode * n) {
-            n->addNewAttribute(OFFSET_ATTRIBUTE, this);
-        }
+        size_t size() const { return entries.size(); };
+
+        DieAnnotation & operator[](uint32_t id) { return entries[id]; };
+
+        DieAnnotation * find(uint64_t offset) {
+            uint32_t * id = ids.find(offset);
+            return id == NULL ? NULL : &entries[*id];
+        };
+
+        DieAnnotation * find(SgNode * n) {
+            SgAsmDwarfConstruct * c = isSgAsmDwarfConstruct(n);
+            return c == NULL ? NULL : find(c->get_offset());
+        };
+
+        // The table the converter is working on.
+        static DieTable * current() { return currentTable; };
+        static void setCurrent(DieTable * t) { currentTable = t; };
+
+    private:
+        std::vector<DieAnnotation> entries;
+        OffsetIndex<uint32_t> ids;
+        static DieTable * currentTable;
+
+        DieTable(DieTable const &);
+        void operator=(DieTable const &);
 };
 
-typedef std::map<std::string, SgAsmDwarfConstruct*> offsetMapType;
+inline DieAnnotation * DieAnnotation::get(SgNode * n) {
+    DieTable * table = DieTable::current();
+    return table == NULL ? NULL : table->find(n);
+}
 
 class InheritedAttribute {
     public:
         SgScopeStatement * parentScope;
+        // Inside a pruned construct
+        bool pruned;
 
-        InheritedAttribute(SgScopeStatement * p = NULL) : parentScope(p) {};
+        InheritedAttribute(SgScopeStatement * p = NULL, bool n = false) : parentScope(p), pruned(n) {};
 };                                                                     
 
 
@@ -0,0 +1,230 @@
+// Micro-benchmark for indexing and annotating a compilation unit: the
+// original two steps, a query that collects every construct into a
+// vector followed by a loop over the table resolving references, against
+// the single walk down the construct lists that resolves backward
+// references as it goes and patches forward ones afterwards. A synthetic
+// unit is built with the given number of DIEs (one million by default),
+// nested the way types, members and functions nest; references are
+// "<offset>" strings pointing anywhere in the unit.
+//
+//   benchAnnotate [DIE count]
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <sys/time.h>
+#include <boost/lexical_cast.hpp>
+
+#include "dieIndex.h"
+
+struct FakeConstruct {
+    uint64_t offset;
+    std::string typeRef;
+    std::string specRef;
+    std::vector<FakeConstruct *> children;
+};
+
+struct FakeAnnotation {
+    FakeConstruct * construct;
+    FakeConstruct * type;
+    FakeConstruct * spec;
+
+    FakeAnnotation(FakeConstruct * c) : construct(c), type(NULL), spec(NULL) {};
+};
+
+struct FakeTable {
+    std::vector<FakeAnnotation> entries;
+    OffsetIndex<uint32_t> ids;
+
+    uint32_t add(FakeConstruct * c) {
+        uint32_t id = entries.size();
+        entries.push_back(FakeAnnotation(c));
+        ids.insert(c->offset, id);
+        return id;
+    };
+
+    FakeAnnotation * find(uint64_t offset) {
+        uint32_t * id = ids.find(offset);
+        return id == NULL ? NULL : &entries[*id];
+    };
+};
+
+struct PendingRef {
+    uint32_t id;
+    uint64_t offset;
+    bool spec;
+
+    PendingRef(uint32_t i, uint64_t o, bool s) : id(i), offset(o), spec(s) {};
+};
+
+static double now() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static std::string refString(uint64_t offset) {
+    return "<" + boost::lexical_cast<std::string>(offset) + ">";
+}
+
+// What NodeQuery::querySubTree does: visit everything below top and
+// return the matches in a new vector.
+static void query(FakeConstruct * c, std::vector<FakeConstruct *> & found, size_t & visits) {
+    ++visits;
+    found.push_back(c);
+    for(size_t i = 0; i < c->children.size(); ++i) {
+        query(c->children[i], found, visits);
+    }
+}
+
+static FakeConstruct * resolve(FakeTable & table, const std::string & ref) {
+    uint64_t offset;
+    if(!parseOffsetRef(ref, offset)) {
+        return NULL;
+    }
+    FakeAnnotation * target = table.find(offset);
+    return target == NULL ? NULL : target->construct;
+}
+
+static size_t twoPass(FakeConstruct * unit, FakeTable & table, size_t & visits) {
+    std::vector<FakeConstruct *> constructs;
+    query(unit, constructs, visits);
+    for(size_t i = 0; i < constructs.size(); ++i) {
+        table.add(constructs[i]);
+    }
+    size_t resolved = 0;
+    for(size_t id = 0; id < table.entries.size(); ++id) {
+        ++visits;
+        FakeAnnotation & attr = table.entries[id];
+        attr.type = resolve(table, attr.construct->typeRef);
+        attr.spec = resolve(table, attr.construct->specRef);
+        resolved += (attr.type != NULL) + (attr.spec != NULL);
+    }
+    return resolved;
+}
+
+static FakeConstruct * resolveOrDefer(FakeTable & table, uint32_t id, const std::string & ref, bool spec,
+        std::vector<PendingRef> & pending) {
+    uint64_t offset;
+    if(!parseOffsetRef(ref, offset)) {
+        return NULL;
+    }
+    FakeAnnotation * target = table.find(offset);
+    if(target == NULL) {
+        pending.push_back(PendingRef(id, offset, spec));
+        return NULL;
+    }
+    return target->construct;
+}
+
+static void index(FakeConstruct * c, FakeTable & table, std::vector<PendingRef> & pending, size_t & visits) {
+    ++visits;
+    uint32_t id = table.add(c);
+    FakeConstruct * type = resolveOrDefer(table, id, c->typeRef, false, pending);
+    FakeConstruct * spec = resolveOrDefer(table, id, c->specRef, true, pending);
+    table.entries[id].type = type;
+    table.entries[id].spec = spec;
+    for(size_t i = 0; i < c->children.size(); ++i) {
+        index(c->children[i], table, pending, visits);
+    }
+}
+
+static size_t onePass(FakeConstruct * unit, FakeTable & table, size_t & visits, size_t & patched) {
+    std::vector<PendingRef> pending;
+    index(unit, table, pending, visits);
+    for(size_t i = 0; i < pending.size(); ++i) {
+        FakeAnnotation * target = table.find(pending[i].offset);
+        if(target == NULL) {
+            continue;
+        }
+        if(pending[i].spec) {
+            table.entries[pending[i].id].spec = target->construct;
+        } else {
+            table.entries[pending[i].id].type = target->construct;
+        }
+    }
+    patched = pending.size();
+    size_t resolved = 0;
+    for(size_t id = 0; id < table.entries.size(); ++id) {
+        resolved += (table.entries[id].type != NULL) + (table.entries[id].spec != NULL);
+    }
+    return resolved;
+}
+
+// Lays out count DIEs in preorder, nesting a few levels deep.
+static void build(std::vector<FakeConstruct> & dies, size_t & next, FakeConstruct * parent, int depth) {
+    while(next < dies.size()) {
+        FakeConstruct * c = &dies[next++];
+        parent->children.push_back(c);
+        if(depth < 4 && rand() % 4 == 0) {
+            build(dies, next, c, depth + 1);
+        }
+        if(depth > 0 && rand() % 8 == 0) {
+            return;
+        }
+    }
+}
+
+int main(int argc, char * argv[]) {
+    size_t count = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000000;
+    if(count < 2) {
+        fprintf(stderr, "usage: %s [DIE count]\n", argv[0]);
+        return 1;
+    }
+
+    srand(42);
+    std::vector<FakeConstruct> dies(count);
+    uint64_t offset = 11;
+    for(size_t i = 0; i < count; ++i) {
+        dies[i].offset = offset;
+        offset += 4 + rand() % 40;
+    }
+    for(size_t i = 1; i < count; ++i) {
+        if(rand() % 10 < 8) {
+            dies[i].typeRef = refString(dies[rand() % count].offset);
+        }
+        if(rand() % 20 == 0) {
+            dies[i].specRef = refString(dies[rand() % count].offset);
+        }
+    }
+    size_t next = 1;
+    build(dies, next, &dies[0], 0);
+
+    // Best of a few rounds, alternating, so neither gets a warmer heap.
+    size_t twoVisits = 0, oneVisits = 0, patched = 0, twoResolved = 0, oneResolved = 0;
+    double twoTime = 0, oneTime = 0;
+    for(int round = 0; round < 3; ++round) {
+        twoVisits = oneVisits = 0;
+        double t0 = now();
+        {
+            FakeTable table;
+            twoResolved = twoPass(&dies[0], table, twoVisits);
+        }
+        double t1 = now();
+        {
+            FakeTable table;
+            oneResolved = onePass(&dies[0], table, oneVisits, patched);
+        }
+        double t2 = now();
+        if(round == 0 || t1 - t0 < twoTime) {
+            twoTime = t1 - t0;
+        }
+        if(round == 0 || t2 - t1 < oneTime) {
+            oneTime = t2 - t1;
+        }
+    }
+    if(twoResolved != oneResolved) {
+        fprintf(stderr, "ERROR: resolved %lu references in two passes but %lu in one\n",
+                (unsigned long)twoResolved, (unsigned long)oneResolved);
+        return 1;
+    }
+
+    printf("%lu DIEs, %lu references, %lu patched after the walk\n", (unsigned long)count,
+           (unsigned long)oneResolved, (unsigned long)patched);
+    printf("%-24s %12s %12s\n", "", "visits", "time (s)");
+    printf("%-24s %12lu %12.3f\n", "query, then annotate", (unsigned long)twoVisits, twoTime);
+    printf("%-24s %12lu %12.3f\n", "single walk", (unsigned long)oneVisits, oneTime);
+    printf("speedup %.1fx\n", twoTime / oneTime);
+    return 0;
+}
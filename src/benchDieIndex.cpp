@@ -0,0 +1,133 @@
+// Micro-benchmark for reference resolution: the original string-keyed
+// std::map against OffsetIndex. A synthetic compilation unit is built
+// with the given number of DIEs (one million by default); most of them
+// carry a type reference and a few a specification reference, stored as
+// "<offset>" strings the way ROSE stores them.
+//
+//   benchDieIndex [DIE count]
+
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <vector>
+#include <sys/time.h>
+#include <boost/lexical_cast.hpp>
+
+#include "dieIndex.h"
+
+struct FakeConstruct {
+    uint64_t offset;
+    std::string typeRef;
+    std::string specRef;
+    FakeConstruct * type;
+    FakeConstruct * spec;
+};
+
+static double now() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static std::string refString(uint64_t offset) {
+    return "<" + boost::lexical_cast<std::string>(offset) + ">";
+}
+
+// The lookups undwarf did before: two count() calls and an operator[]
+// per construct, on strings built from the offset.
+static size_t stringMap(std::vector<FakeConstruct> & dies, double & buildTime, double & resolveTime) {
+    double t0 = now();
+    std::map<std::string, FakeConstruct *> map;
+    for(size_t i = 0; i < dies.size(); ++i) {
+        map[refString(dies[i].offset)] = &dies[i];
+    }
+    double t1 = now();
+    size_t resolved = 0;
+    for(size_t i = 0; i < dies.size(); ++i) {
+        FakeConstruct & c = dies[i];
+        c.type = c.spec = NULL;
+        if(map.count(c.typeRef) > 0) {
+            c.type = map[c.typeRef];
+            ++resolved;
+        }
+        if(map.count(c.specRef) > 0) {
+            c.spec = map[c.specRef];
+            ++resolved;
+        }
+    }
+    double t2 = now();
+    buildTime = t1 - t0;
+    resolveTime = t2 - t1;
+    return resolved;
+}
+
+static size_t offsetIndex(std::vector<FakeConstruct> & dies, double & buildTime, double & resolveTime) {
+    double t0 = now();
+    OffsetIndex<FakeConstruct *> index(dies.size());
+    for(size_t i = 0; i < dies.size(); ++i) {
+        index.insert(dies[i].offset, &dies[i]);
+    }
+    double t1 = now();
+    size_t resolved = 0;
+    for(size_t i = 0; i < dies.size(); ++i) {
+        FakeConstruct & c = dies[i];
+        c.type = c.spec = NULL;
+        uint64_t offset;
+        FakeConstruct ** target;
+        if(parseOffsetRef(c.typeRef, offset) && (target = index.find(offset)) != NULL) {
+            c.type = *target;
+            ++resolved;
+        }
+        if(parseOffsetRef(c.specRef, offset) && (target = index.find(offset)) != NULL) {
+            c.spec = *target;
+            ++resolved;
+        }
+    }
+    double t2 = now();
+    buildTime = t1 - t0;
+    resolveTime = t2 - t1;
+    return resolved;
+}
+
+int main(int argc, char * argv[]) {
+    size_t count = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000000;
+    if(count == 0) {
+        fprintf(stderr, "usage: %s [DIE count]\n", argv[0]);
+        return 1;
+    }
+
+    // Offsets grow by a typical DIE size; references point anywhere in
+    // the unit, as type references do.
+    srand(42);
+    std::vector<FakeConstruct> dies(count);
+    uint64_t offset = 11;
+    for(size_t i = 0; i < count; ++i) {
+        dies[i].offset = offset;
+        offset += 4 + rand() % 40;
+    }
+    for(size_t i = 0; i < count; ++i) {
+        if(rand() % 10 < 8) {
+            dies[i].typeRef = refString(dies[rand() % count].offset);
+        }
+        if(rand() % 20 == 0) {
+            dies[i].specRef = refString(dies[rand() % count].offset);
+        }
+    }
+
+    double mapBuild, mapResolve, indexBuild, indexResolve;
+    size_t mapResolved = stringMap(dies, mapBuild, mapResolve);
+    size_t indexResolved = offsetIndex(dies, indexBuild, indexResolve);
+    if(mapResolved != indexResolved) {
+        fprintf(stderr, "ERROR: resolved %lu references with the map but %lu with the index\n",
+                (unsigned long)mapResolved, (unsigned long)indexResolved);
+        return 1;
+    }
+
+    printf("%lu DIEs, %lu references\n", (unsigned long)count, (unsigned long)mapResolved);
+    printf("%-24s %12s %12s %12s\n", "", "build (s)", "resolve (s)", "total (s)");
+    printf("%-24s %12.3f %12.3f %12.3f\n", "std::map<std::string>", mapBuild, mapResolve, mapBuild + mapResolve);
+    printf("%-24s %12.3f %12.3f %12.3f\n", "OffsetIndex", indexBuild, indexResolve, indexBuild + indexResolve);
+    printf("speedup %.1fx\n", (mapBuild + mapResolve) / (indexBuild + indexResolve));
+    return 0;
+}
@@ -0,0 +1,133 @@
+// Micro-benchmark for filling a scope with ROSE's own nodes: SageInterface's
+// insertStatementAfterLastDeclaration, prependStatement and
+// insertStatementBefore, which undwarf used to call once per declaration,
+// against ScopeQueue and one flush. Each is timed filling its own
+// namespace with the given number of members (100,000 by default); every
+// tenth member needs a structure that hasn't been declared yet, which
+// gets a forward declaration at the front and its definition just before
+// the member, as convertType does. The statements are built before the
+// clock starts.
+//
+//   benchScopeQueue [member count]
+
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <vector>
+#include <sys/time.h>
+#include <boost/unordered_map.hpp>
+
+#include "rose.h"
+#include "scopeQueue.h"
+
+static double now() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static SgNamespaceDefinitionStatement * buildNamespace(const char * name, SgGlobal * global) {
+    SgNamespaceDeclarationStatement * decl = SageBuilder::buildNamespaceDeclaration_nfi(SgName(name), false, global);
+    SageInterface::setOneSourcePositionForTransformation(decl);
+    SageInterface::setOneSourcePositionForTransformation(decl->get_firstNondefiningDeclaration());
+    SageBuilder::buildNamespaceDefinition(decl);
+    SageInterface::appendStatement(decl, global);
+    return decl->get_definition();
+}
+
+// Per member, in scope: the member, and for every tenth a definition of
+// the structure it needs and that structure's forward declaration.
+static std::vector<SgStatement *> buildStatements(size_t count, SgNamespaceDefinitionStatement * scope) {
+    std::vector<SgStatement *> statements(count * 3, NULL);
+    for(size_t i = 0; i < count; ++i) {
+        std::ostringstream member;
+        member << "m" << i;
+        statements[3 * i] = SageBuilder::buildVariableDeclaration(SgName(member.str()), SageBuilder::buildIntType(), NULL, scope);
+        if(i % 10 == 0) {
+            std::ostringstream record;
+            record << "S" << i;
+            SgClassDeclaration * forward = SageBuilder::buildNondefiningClassDeclaration_nfi(SgName(record.str()),
+                    SgClassDeclaration::e_struct, scope);
+            SgClassDeclaration * definition = SageBuilder::buildClassDeclaration_nfi(SgName(record.str()),
+                    SgClassDeclaration::e_struct, scope, forward);
+            statements[3 * i + 1] = definition;
+            statements[3 * i + 2] = forward;
+        }
+    }
+    return statements;
+}
+
+// Attaches the queued declarations, as undwarf does.
+struct AppendStatement {
+    void operator()(SgScopeStatement * scope, SgStatement * s) const {
+        scope->append_statement(s);
+    };
+};
+
+// Where each statement of built ended up in scope, by its index in built.
+static std::vector<size_t> order(SgNamespaceDefinitionStatement * scope, const std::vector<SgStatement *> & built) {
+    boost::unordered_map<SgStatement *, size_t> index;
+    for(size_t i = 0; i < built.size(); ++i) {
+        index[built[i]] = i;
+    }
+    std::vector<size_t> result;
+    SgDeclarationStatementPtrList & list = scope->get_declarations();
+    for(size_t i = 0; i < list.size(); ++i) {
+        result.push_back(index[list[i]]);
+    }
+    return result;
+}
+
+int main(int argc, char * argv[]) {
+    size_t count = argc > 1 ? strtoul(argv[1], NULL, 10) : 100000;
+    if(count == 0) {
+        fprintf(stderr, "usage: %s [member count]\n", argv[0]);
+        return 1;
+    }
+
+    SgSourceFile * file = new SgSourceFile();
+    file->set_Cxx_only(true);
+    SgGlobal * global = new SgGlobal();
+    file->set_globalScope(global);
+    global->set_parent(file);
+    SageInterface::setSourcePositionForTransformation(global);
+
+    SgNamespaceDefinitionStatement * direct = buildNamespace("direct", global);
+    SgNamespaceDefinitionStatement * queued = buildNamespace("queued", global);
+    std::vector<SgStatement *> directStatements = buildStatements(count, direct);
+    std::vector<SgStatement *> queuedStatements = buildStatements(count, queued);
+
+    double t0 = now();
+    for(size_t i = 0; i < count; ++i) {
+        SgStatement * member = directStatements[3 * i];
+        SageInterface::insertStatementAfterLastDeclaration(member, direct);
+        if(i % 10 == 0) {
+            SageInterface::insertStatementBefore(member, directStatements[3 * i + 1]);
+            SageInterface::prependStatement(directStatements[3 * i + 2], direct);
+        }
+    }
+    double t1 = now();
+    ScopeQueue<SgScopeStatement, SgStatement> queue;
+    for(size_t i = 0; i < count; ++i) {
+        SgStatement * member = queuedStatements[3 * i];
+        queue.append(queued, member);
+        if(i % 10 == 0) {
+            queue.insertBefore(queued, member, queuedStatements[3 * i + 1]);
+            queue.prepend(queued, queuedStatements[3 * i + 2]);
+        }
+    }
+    queue.flush(AppendStatement());
+    double t2 = now();
+
+    if(order(direct, directStatements) != order(queued, queuedStatements)) {
+        fprintf(stderr, "ERROR: the queue put the statements in a different order\n");
+        return 1;
+    }
+
+    printf("%lu members, %lu statements\n", (unsigned long)count, (unsigned long)queued->get_declarations().size());
+    printf("%-24s %12s\n", "", "time (s)");
+    printf("%-24s %12.3f\n", "SageInterface", t1 - t0);
+    printf("%-24s %12.3f\n", "ScopeQueue", t2 - t1);
+    printf("speedup %.1fx\n", (t1 - t0) / (t2 - t1));
+    return 0;
+}
@@ -0,0 +1,72 @@
+#ifndef __BOUNDEDQUEUE_H__
+#define __BOUNDEDQUEUE_H__
+
+#include <deque>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+// A fixed-capacity FIFO between two pipeline stages. push() waits while
+// the queue is full and pop() while it is empty, so a fast stage can get
+// at most capacity items ahead of a slow one. Once the producer calls
+// close(), pop() drains what is left and then returns false.
+//
+// The queue also keeps track of how full it got, for reporting.
+template <class T>
+class BoundedQueue {
+    public:
+        explicit BoundedQueue(size_t c) : capacity(c == 0 ? 1 : c), closed(false), pushes(0), depthSum(0), peak(0) {};
+
+        void push(const T & item) {
+            boost::mutex::scoped_lock lock(mutex);
+            while(items.size() >= capacity) {
+                notFull.wait(lock);
+            }
+            items.push_back(item);
+            ++pushes;
+            depthSum += items.size();
+            if(items.size() > peak) {
+                peak = items.size();
+            }
+            notEmpty.notify_one();
+        };
+
+        bool pop(T & item) {
+            boost::mutex::scoped_lock lock(mutex);
+            while(items.empty() && !closed) {
+                notEmpty.wait(lock);
+            }
+            if(items.empty()) {
+                return false;
+            }
+            item = items.front();
+            items.pop_front();
+            notFull.notify_one();
+            return true;
+        };
+
+        void close() {
+            boost::mutex::scoped_lock lock(mutex);
+            closed = true;
+            notEmpty.notify_all();
+        };
+
+        // Deepest the queue has been, and its average depth just after a push.
+        size_t maxDepth() const { return peak; };
+        double averageDepth() const { return pushes == 0 ? 0.0 : static_cast<double>(depthSum) / pushes; };
+
+    private:
+        std::deque<T> items;
+        const size_t capacity;
+        bool closed;
+        size_t pushes;
+        size_t depthSum;
+        size_t peak;
+        boost::mutex mutex;
+        boost::condition_variable notEmpty;
+        boost::condition_variable notFull;
+
+        BoundedQueue(BoundedQueue const &);
+        void operator=(BoundedQueue const &);
+};
+
+#endif
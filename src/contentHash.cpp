@@ -0,0 +1,107 @@
+#include "contentHash.h"
+#include <cstring>
+#include <algorithm>
+
+static const uint64_t C1 = 0x87c37b91114253d5ULL;
+static const uint64_t C2 = 0x4cf5ad432745937fULL;
+
+static inline uint64_t rotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t fmix(uint64_t k) {
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+    return k;
+}
+
+// Little-endian, whatever the host, so digests can be shared.
+static inline uint64_t load(const unsigned char * p) {
+    uint64_t v = 0;
+    for(int i = 7; i >= 0; --i) {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+std::string ContentDigest::hex() const {
+    static const char digits[] = "0123456789abcdef";
+    std::string s(32, '0');
+    for(int i = 0; i < 16; ++i) {
+        s[15 - i] = digits[(high >> (4 * i)) & 0xf];
+        s[31 - i] = digits[(low >> (4 * i)) & 0xf];
+    }
+    return s;
+}
+
+ContentHasher::ContentHasher() : h1(0), h2(0), tailSize(0), total(0) {
+}
+
+void ContentHasher::block(const unsigned char * data) {
+    uint64_t k1 = load(data);
+    uint64_t k2 = load(data + 8);
+
+    k1 *= C1; k1 = rotl(k1, 31); k1 *= C2; h1 ^= k1;
+    h1 = rotl(h1, 27); h1 += h2; h1 = h1 * 5 + 0x52dce729;
+
+    k2 *= C2; k2 = rotl(k2, 33); k2 *= C1; h2 ^= k2;
+    h2 = rotl(h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495ab5;
+}
+
+void ContentHasher::update(const void * data, size_t size) {
+    const unsigned char * p = static_cast<const unsigned char *>(data);
+    total += size;
+    if(tailSize > 0) {
+        size_t n = std::min(size, sizeof(tail) - tailSize);
+        memcpy(tail + tailSize, p, n);
+        tailSize += n;
+        p += n;
+        size -= n;
+        if(tailSize < sizeof(tail)) {
+            return;
+        }
+        block(tail);
+        tailSize = 0;
+    }
+    for(; size >= 16; p += 16, size -= 16) {
+        block(p);
+    }
+    memcpy(tail, p, size);
+    tailSize = size;
+}
+
+ContentDigest ContentHasher::digest() const {
+    uint64_t a = h1;
+    uint64_t b = h2;
+    uint64_t k1 = 0;
+    uint64_t k2 = 0;
+    for(size_t i = tailSize; i > 8; --i) {
+        k2 = (k2 << 8) | tail[i - 1];
+    }
+    for(size_t i = std::min(tailSize, static_cast<size_t>(8)); i > 0; --i) {
+        k1 = (k1 << 8) | tail[i - 1];
+    }
+    if(tailSize > 8) {
+        k2 *= C2; k2 = rotl(k2, 33); k2 *= C1; b ^= k2;
+    }
+    if(tailSize > 0) {
+        k1 *= C1; k1 = rotl(k1, 31); k1 *= C2; a ^= k1;
+    }
+
+    a ^= total;
+    b ^= total;
+    a += b;
+    b += a;
+    a = fmix(a);
+    b = fmix(b);
+    a += b;
+    b += a;
+
+    ContentDigest d;
+    d.high = a;
+    d.low = b;
+    return d;
+}
@@ -0,0 +1,44 @@
+#ifndef __CONTENTHASH_H__
+#define __CONTENTHASH_H__
+
+#include <stdint.h>
+#include <cstddef>
+#include <string>
+
+// A 128-bit digest, good enough to name cache entries by their content.
+struct ContentDigest {
+    uint64_t high;
+    uint64_t low;
+
+    ContentDigest() : high(0), low(0) {};
+
+    // 32 lowercase hex digits.
+    std::string hex() const;
+
+    bool operator<(const ContentDigest & o) const { return high < o.high || (high == o.high && low < o.low); };
+};
+
+// MurmurHash3 (x64, 128-bit) over everything passed to update(), in any
+// number of pieces. Not cryptographic, but fast and well mixed, which is
+// what keying a cache on gigabytes of debug information needs.
+class ContentHasher {
+    public:
+        ContentHasher();
+
+        void update(const void * data, size_t size);
+        void update(const std::string & s) { update(s.data(), s.size()); };
+        void update(uint64_t v) { update(&v, sizeof(v)); };
+
+        ContentDigest digest() const;
+
+    private:
+        uint64_t h1;
+        uint64_t h2;
+        unsigned char tail[16];
+        size_t tailSize;
+        uint64_t total;
+
+        void block(const unsigned char * data);
+};
+
+#endif
@@ -0,0 +1,405 @@
+#include "declarationOrder.h"
+#include <string>
+#include <utility>
+#include <vector>
+#include <boost/foreach.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/unordered_set.hpp>
+
+namespace {
+
+typedef std::pair<SgScopeStatement *, std::string> RecordKey;
+
+// Where a declaration sits: its scope, its index there, and the
+// declaration in the enclosing scope whose body holds that scope.
+struct Place {
+    SgScopeStatement * scope;
+    size_t index;
+    SgDeclarationStatement * owner;
+
+    Place(SgScopeStatement * s = NULL, size_t i = 0, SgDeclarationStatement * o = NULL) : scope(s), index(i), owner(o) {};
+};
+
+// The graph of one scope: for each declaration, those it must follow,
+// and the records it refers to without needing them complete.
+struct ScopeGraph {
+    SgScopeStatement * scope;
+    SgDeclarationStatementPtrList * list;
+    std::vector<std::vector<size_t> > needs;
+    std::vector<std::vector<std::string> > mentions;
+
+    ScopeGraph() : scope(NULL), list(NULL) {};
+};
+
+static SgDeclarationStatementPtrList * declarationsOf(SgScopeStatement * scope) {
+    if(SgGlobal * g = isSgGlobal(scope)) {
+        return &g->get_declarations();
+    }
+    if(SgNamespaceDefinitionStatement * ns = isSgNamespaceDefinitionStatement(scope)) {
+        return &ns->get_declarations();
+    }
+    if(SgClassDefinition * c = isSgClassDefinition(scope)) {
+        return &c->get_members();
+    }
+    return NULL;
+}
+
+// A record declaration without members.
+static bool declaresOnly(SgDeclarationStatement * d) {
+    SgClassDeclaration * c = isSgClassDeclaration(d);
+    return c != NULL && (c->isForward() || c->get_definition() == NULL);
+}
+
+class Sorter {
+    public:
+        size_t sort(SgGlobal * global) {
+            index(global, NULL);
+            BOOST_FOREACH(SgDeclarationStatement * d, order) {
+                collect(d);
+            }
+            size_t dropped = 0;
+            BOOST_FOREACH(SgScopeStatement * scope, scopes) {
+                dropped += emit(graphs[scope]);
+            }
+            return dropped;
+        };
+
+    private:
+        boost::unordered_map<SgDeclarationStatement *, Place> places;
+        boost::unordered_map<RecordKey, SgDeclarationStatement *> definitions;
+        boost::unordered_map<SgScopeStatement *, ScopeGraph> graphs;
+        // The declaration whose body each scope is
+        boost::unordered_map<SgScopeStatement *, SgDeclarationStatement *> owners;
+        // Scopes and declarations in the order they were found, so the
+        // result doesn't depend on pointer values.
+        std::vector<SgScopeStatement *> scopes;
+        std::vector<SgDeclarationStatement *> order;
+
+        void index(SgScopeStatement * scope, SgDeclarationStatement * owner) {
+            SgDeclarationStatementPtrList * list = declarationsOf(scope);
+            if(list == NULL) {
+                return;
+            }
+            ScopeGraph & graph = graphs[scope];
+            graph.scope = scope;
+            graph.list = list;
+            graph.needs.resize(list->size());
+            graph.mentions.resize(list->size());
+            scopes.push_back(scope);
+            owners[scope] = owner;
+            for(size_t i = 0; i < list->size(); ++i) {
+                SgDeclarationStatement * d = (*list)[i];
+                places[d] = Place(scope, i, owner);
+                order.push_back(d);
+                if(SgClassDeclaration * c = isSgClassDeclaration(d)) {
+                    if(!declaresOnly(c)) {
+                        definitions[key(c)] = c;
+                        index(c->get_definition(), c);
+                    }
+                } else if(SgNamespaceDeclarationStatement * ns = isSgNamespaceDeclarationStatement(d)) {
+                    index(ns->get_definition(), ns);
+                }
+            }
+        };
+
+        static RecordKey key(SgClassDeclaration * c) {
+            return RecordKey(c->get_scope(), c->get_name().getString());
+        };
+
+        // What one declaration needs, apart from what its body does.
+        void collect(SgDeclarationStatement * d) {
+            if(SgClassDeclaration * c = isSgClassDeclaration(d)) {
+                if(!declaresOnly(c)) {
+                    BOOST_FOREACH(SgBaseClass * base, c->get_definition()->get_inheritances()) {
+                        SgClassDeclaration * b = base->get_base_class();
+                        if(b != NULL) {
+                            need(d, definitionOf(b));
+                        }
+                    }
+                }
+            } else if(SgVariableDeclaration * v = isSgVariableDeclaration(d)) {
+                BOOST_FOREACH(SgInitializedName * name, v->get_variables()) {
+                    walk(d, name->get_type(), true);
+                }
+            } else if(SgFunctionDeclaration * f = isSgFunctionDeclaration(d)) {
+                walk(d, f->get_type(), false);
+            } else if(SgTypedefDeclaration * t = isSgTypedefDeclaration(d)) {
+                walk(d, t->get_base_type(), false);
+            }
+        };
+
+        // Follows type, used by d; byValue if d needs it complete.
+        void walk(SgDeclarationStatement * d, SgType * type, bool byValue) {
+            if(type == NULL) {
+                return;
+            }
+            switch(type->variantT()) {
+                case V_SgPointerType:
+                    walk(d, isSgPointerType(type)->get_base_type(), false);
+                    break;
+                case V_SgReferenceType:
+                    walk(d, isSgReferenceType(type)->get_base_type(), false);
+                    break;
+                case V_SgModifierType:
+                    walk(d, isSgModifierType(type)->get_base_type(), byValue);
+                    break;
+                case V_SgArrayType:
+                    walk(d, isSgArrayType(type)->get_base_type(), byValue);
+                    break;
+                case V_SgFunctionType: {
+                    SgFunctionType * f = isSgFunctionType(type);
+                    walk(d, f->get_return_type(), false);
+                    BOOST_FOREACH(SgType * argument, f->get_arguments()) {
+                        walk(d, argument, false);
+                    }
+                    break;
+                }
+                case V_SgTypedefType: {
+                    // A typedef can't be declared ahead; what it names
+                    // matters only if it is used by value.
+                    SgTypedefDeclaration * t = isSgTypedefDeclaration(isSgTypedefType(type)->get_declaration());
+                    need(d, t);
+                    if(t != NULL && byValue) {
+                        walk(d, t->get_base_type(), true);
+                    }
+                    break;
+                }
+                case V_SgEnumType:
+                    need(d, isSgEnumType(type)->get_declaration());
+                    break;
+                case V_SgClassType: {
+                    SgClassDeclaration * c = isSgClassDeclaration(isSgClassType(type)->get_declaration());
+                    if(c == NULL) {
+                        break;
+                    }
+                    if(byValue) {
+                        need(d, definitionOf(c));
+                    } else {
+                        mention(d, c);
+                    }
+                    break;
+                }
+                default:
+                    break;
+            }
+        };
+
+        SgDeclarationStatement * definitionOf(SgClassDeclaration * c) {
+            boost::unordered_map<RecordKey, SgDeclarationStatement *>::iterator i = definitions.find(key(c));
+            return i == definitions.end() ? NULL : i->second;
+        };
+
+        // d, or the declaration holding it, that sits directly in scope;
+        // NULL if d isn't inside scope.
+        SgDeclarationStatement * within(SgDeclarationStatement * d, SgScopeStatement * scope) {
+            while(d != NULL) {
+                boost::unordered_map<SgDeclarationStatement *, Place>::iterator p = places.find(d);
+                if(p == places.end()) {
+                    return NULL;
+                }
+                if(p->second.scope == scope) {
+                    return d;
+                }
+                d = p->second.owner;
+            }
+            return NULL;
+        };
+
+        // d needs target first. The edge goes in the innermost scope
+        // holding both, between the declarations there that hold them.
+        void need(SgDeclarationStatement * d, SgDeclarationStatement * target) {
+            if(target == NULL || places.find(target) == places.end()) {
+                return;
+            }
+            for(SgDeclarationStatement * t = target; t != NULL; t = places[t].owner) {
+                const Place & tp = places[t];
+                SgDeclarationStatement * user = within(d, tp.scope);
+                if(user != NULL) {
+                    if(user != t) {
+                        ScopeGraph & graph = graphs[tp.scope];
+                        graph.needs[places[user].index].push_back(tp.index);
+                    }
+                    return;
+                }
+            }
+        };
+
+        // d refers to c through a pointer or reference; that matters to
+        // where c's forward declaration goes in c's own scope. From
+        // outside that scope, d has to follow the declaration holding it,
+        // such as the namespace c is declared in.
+        void mention(SgDeclarationStatement * d, SgClassDeclaration * c) {
+            SgScopeStatement * scope = c->get_scope();
+            SgDeclarationStatement * user = within(d, scope);
+            if(user != NULL) {
+                graphs[scope].mentions[places[user].index].push_back(c->get_name().getString());
+                return;
+            }
+            boost::unordered_map<SgScopeStatement *, SgDeclarationStatement *>::iterator owner = owners.find(scope);
+            if(owner != owners.end()) {
+                need(d, owner->second);
+            }
+        };
+
+        // Rewrites the scope's list in dependency order; returns how many
+        // forward declarations it dropped.
+        size_t emit(ScopeGraph & graph) {
+            SgDeclarationStatementPtrList & list = *graph.list;
+            const size_t n = list.size();
+            // Each record's definition, and its first bare declaration.
+            boost::unordered_map<std::string, size_t> defined;
+            boost::unordered_map<std::string, size_t> declared;
+            for(size_t i = 0; i < n; ++i) {
+                SgClassDeclaration * c = isSgClassDeclaration(list[i]);
+                if(c == NULL) {
+                    continue;
+                }
+                std::string name = c->get_name().getString();
+                if(declaresOnly(c)) {
+                    declared.insert(std::make_pair(name, i));
+                } else {
+                    defined.insert(std::make_pair(name, i));
+                }
+            }
+
+            // Bare declarations are placed on demand, except for records
+            // that aren't defined here, which keep their first one.
+            std::vector<bool> placeLater(n, false);
+            for(size_t i = 0; i < n; ++i) {
+                SgClassDeclaration * c = isSgClassDeclaration(list[i]);
+                if(c != NULL && declaresOnly(c)) {
+                    std::string name = c->get_name().getString();
+                    placeLater[i] = defined.count(name) > 0 || declared[name] != i;
+                }
+            }
+
+            SgDeclarationStatementPtrList sorted;
+            sorted.reserve(n);
+            std::vector<char> state(n, NEW);
+            boost::unordered_map<std::string, bool> forwarded;
+            created = 0;
+            for(size_t i = 0; i < n; ++i) {
+                if(!placeLater[i]) {
+                    visit(graph, i, state, defined, declared, forwarded, sorted);
+                }
+            }
+            size_t dropped = n + created - sorted.size();
+            list.swap(sorted);
+            if(dropped != 0) {
+                release(graph, sorted);
+            }
+            return dropped;
+        };
+
+        // Deletes the bare declarations of old that the scope's new list
+        // left out. What referred to one (the record's symbol and type,
+        // and each declaration's first nondefining declaration) is moved
+        // to the first bare declaration that stayed, or else to the
+        // definition.
+        void release(ScopeGraph & graph, const SgDeclarationStatementPtrList & old) {
+            const SgDeclarationStatementPtrList & list = *graph.list;
+            boost::unordered_set<SgDeclarationStatement *> kept(list.begin(), list.end());
+            boost::unordered_map<std::string, std::vector<SgClassDeclaration *> > records;
+            boost::unordered_map<std::string, SgClassDeclaration *> bare;
+            boost::unordered_map<std::string, SgClassDeclaration *> defining;
+            BOOST_FOREACH(SgDeclarationStatement * d, list) {
+                SgClassDeclaration * c = isSgClassDeclaration(d);
+                if(c == NULL) {
+                    continue;
+                }
+                std::string name = c->get_name().getString();
+                records[name].push_back(c);
+                if(declaresOnly(c)) {
+                    bare.insert(std::make_pair(name, c));
+                } else {
+                    defining.insert(std::make_pair(name, c));
+                }
+            }
+            BOOST_FOREACH(SgDeclarationStatement * d, old) {
+                SgClassDeclaration * gone = isSgClassDeclaration(d);
+                if(gone == NULL || kept.count(gone) > 0) {
+                    continue;
+                }
+                std::string name = gone->get_name().getString();
+                SgClassDeclaration * stays = bare.count(name) > 0 ? bare[name] : defining[name];
+                if(stays == NULL) {
+                    continue;
+                }
+                BOOST_FOREACH(SgClassDeclaration * c, records[name]) {
+                    if(c->get_firstNondefiningDeclaration() == gone) {
+                        c->set_firstNondefiningDeclaration(stays);
+                    }
+                }
+                SgClassSymbol * symbol = graph.scope->lookup_class_symbol(gone->get_name());
+                if(symbol != NULL && symbol->get_declaration() == gone) {
+                    symbol->set_declaration(stays);
+                }
+                SgClassType * type = gone->get_type();
+                if(type != NULL && type->get_declaration() == gone) {
+                    type->set_declaration(stays);
+                }
+                SageInterface::deleteAST(gone);
+            }
+        };
+
+        enum { NEW, ACTIVE, DONE };
+
+        // Forward declarations emit() had to make
+        size_t created;
+
+        // A new forward declaration of the record defined at index k.
+        SgClassDeclaration * forward(ScopeGraph & graph, size_t k) {
+            SgClassDeclaration * definition = isSgClassDeclaration((*graph.list)[k]);
+            SgClassDeclaration * decl = SageBuilder::buildNondefiningClassDeclaration_nfi(definition->get_name(),
+                    definition->get_class_type(), graph.scope);
+            SageInterface::setOneSourcePositionForTransformation(decl);
+            SageInterface::fixStatement(decl, graph.scope);
+            decl->set_parent(graph.scope);
+            ++created;
+            return decl;
+        };
+
+        void visit(ScopeGraph & graph, size_t i, std::vector<char> & state,
+                const boost::unordered_map<std::string, size_t> & defined,
+                const boost::unordered_map<std::string, size_t> & declared,
+                boost::unordered_map<std::string, bool> & forwarded,
+                SgDeclarationStatementPtrList & sorted) {
+            if(state[i] != NEW) {
+                // Done, or a cycle through types used by value, which
+                // valid input doesn't have.
+                return;
+            }
+            state[i] = ACTIVE;
+            BOOST_FOREACH(size_t need, graph.needs[i]) {
+                visit(graph, need, state, defined, declared, forwarded, sorted);
+            }
+            BOOST_FOREACH(const std::string & name, graph.mentions[i]) {
+                boost::unordered_map<std::string, size_t>::const_iterator d = defined.find(name);
+                boost::unordered_map<std::string, size_t>::const_iterator f = declared.find(name);
+                if(d == defined.end() || d->second == i || state[d->second] == DONE || forwarded[name]) {
+                    continue;
+                }
+                if(f != declared.end()) {
+                    sorted.push_back((*graph.list)[f->second]);
+                    forwarded[name] = true;
+                } else if(state[d->second] == ACTIVE) {
+                    // A cycle through pointers, which only a forward
+                    // declaration breaks.
+                    sorted.push_back(forward(graph, d->second));
+                    forwarded[name] = true;
+                } else {
+                    // Nothing to declare it with; the definition will do.
+                    visit(graph, d->second, state, defined, declared, forwarded, sorted);
+                }
+            }
+            sorted.push_back((*graph.list)[i]);
+            state[i] = DONE;
+        };
+};
+
+}
+
+size_t DeclarationOrder::sort(SgGlobal * global) {
+    Sorter sorter;
+    return sorter.sort(global);
+}
@@ -0,0 +1,22 @@
+#ifndef __DECLARATIONORDER_H__
+#define __DECLARATIONORDER_H__
+
+#include "rose.h"
+
+// Puts the declarations of a generated file in an order a compiler
+// accepts, whatever order conversion produced them in. Within each
+// scope, every declaration follows the typedefs and enums it names and
+// the records it uses by value (as a member, base or array element);
+// otherwise the original order is kept, so data members stay where their
+// layout puts them. A record defined in the same scope keeps a forward
+// declaration only if something refers to it through a pointer or
+// reference before the definition, as in a cycle; a cycle that has none
+// gets one. Runs in time linear in the size of the file, times its
+// nesting depth.
+namespace DeclarationOrder {
+    // Reorders every scope in global. Returns how many forward
+    // declarations were dropped; they are deleted.
+    size_t sort(SgGlobal * global);
+}
+
+#endif
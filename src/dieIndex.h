@@ -0,0 +1,126 @@
+#ifndef __DIEINDEX_H__
+#define __DIEINDEX_H__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Open-addressing hash table keyed by DIE offset. Offsets are hashed
+// with a multiplicative (Fibonacci) hash and collisions are resolved by
+// linear probing, so a lookup is usually a single cache line. The table
+// is kept at most half full. Entries can't be removed; the whole index is
+// thrown away when its compilation unit is done.
+template <class T>
+class OffsetIndex {
+    public:
+        explicit OffsetIndex(size_t expected = 0) : count(0), shift(64) {
+            reserve(expected);
+        };
+
+        void reserve(size_t expected) {
+            size_t capacity = 16;
+            while(capacity < expected * 2) {
+                capacity *= 2;
+            }
+            if(capacity > slots.size()) {
+                rehash(capacity);
+            }
+        };
+
+        // Adds or replaces the value stored for offset.
+        void insert(uint64_t offset, const T & value) {
+            if((count + 1) * 2 > slots.size()) {
+                rehash(slots.empty() ? 16 : slots.size() * 2);
+            }
+            size_t i = probe(offset);
+            if(slots[i].key == EMPTY) {
+                slots[i].key = offset;
+                ++count;
+            }
+            slots[i].value = value;
+        };
+
+        // Returns NULL if there is no entry for offset.
+        T * find(uint64_t offset) {
+            if(slots.empty()) {
+                return NULL;
+            }
+            size_t i = probe(offset);
+            return slots[i].key == EMPTY ? NULL : &slots[i].value;
+        };
+
+        const T * find(uint64_t offset) const {
+            return const_cast<OffsetIndex *>(this)->find(offset);
+        };
+
+        size_t size() const { return count; };
+
+        void clear() {
+            std::vector<Slot>().swap(slots);
+            count = 0;
+            shift = 64;
+        };
+
+    private:
+        struct Slot {
+            uint64_t key;
+            T value;
+        };
+
+        static const uint64_t EMPTY = ~static_cast<uint64_t>(0);
+
+        std::vector<Slot> slots;
+        size_t count;
+        unsigned shift;
+
+        // Index of the slot holding key, or of the empty slot where it
+        // would go.
+        size_t probe(uint64_t key) const {
+            const size_t mask = slots.size() - 1;
+            size_t i = static_cast<size_t>((key * 0x9E3779B97F4A7C15ULL) >> shift);
+            while(slots[i].key != EMPTY && slots[i].key != key) {
+                i = (i + 1) & mask;
+            }
+            return i;
+        };
+
+        void rehash(size_t capacity) {
+            std::vector<Slot> old;
+            old.swap(slots);
+            Slot empty;
+            empty.key = EMPTY;
+            empty.value = T();
+            slots.assign(capacity, empty);
+            shift = 64;
+            for(size_t c = capacity; c > 1; c >>= 1) {
+                --shift;
+            }
+            for(size_t i = 0; i < old.size(); ++i) {
+                if(old[i].key != EMPTY) {
+                    slots[probe(old[i].key)] = old[i];
+                }
+            }
+        };
+};
+
+// Parses a DIE reference in the "<offset>" form ROSE stores type and
+// specification references in. Returns false for empty or malformed
+// references.
+inline bool parseOffsetRef(const std::string & ref, uint64_t & offset) {
+    const size_t n = ref.size();
+    if(n < 3 || ref[0] != '<' || ref[n - 1] != '>') {
+        return false;
+    }
+    uint64_t value = 0;
+    for(size_t i = 1; i < n - 1; ++i) {
+        char c = ref[i];
+        if(c < '0' || c > '9') {
+            return false;
+        }
+        value = value * 10 + (c - '0');
+    }
+    offset = value;
+    return true;
+}
+
+#endif
@@ -0,0 +1,182 @@
+#include "dwarfBuilder.h"
+#include "rose.h"
+#include "dwarf.h"
+#include <vector>
+#include <boost/lexical_cast.hpp>
+
+// Offsets are formatted the way the ROSE frontend stores references.
+static std::string refString(uint64_t offset) {
+    return "<" + boost::lexical_cast<std::string>(offset) + ">";
+}
+
+// Decide whether a DIE is worth building a node for. Skipped DIEs are
+// still descended into, since they can contain type definitions; their
+// children are attached to the nearest materialized ancestor, which is
+// what the traversal would have seen anyway.
+static bool shouldMaterialize(const DwarfUnit & unit, const DwarfDie & die) {
+    uint32_t parentTag = die.parent == DwarfDie::NONE ? 0 : unit.dies[die.parent].tag;
+    switch(die.tag) {
+        // Parameters of inlined calls must not end up in the enclosing
+        // function's parameter list.
+        case DW_TAG_formal_parameter:
+            return parentTag == DW_TAG_subprogram || parentTag == DW_TAG_subroutine_type;
+
+        case DW_TAG_variable:
+        case DW_TAG_lexical_block:
+        case DW_TAG_inlined_subroutine:
+        case DW_TAG_label:
+        case DW_TAG_unspecified_parameters:
+        case DW_TAG_template_type_parameter:
+        case DW_TAG_template_value_parameter:
+        case DW_TAG_imported_declaration:
+        case DW_TAG_imported_module:
+        case DW_TAG_GNU_template_parameter_pack:
+        case DW_TAG_GNU_formal_parameter_pack:
+        case 0x4109: // DW_TAG_GNU_call_site
+        case 0x410a: // DW_TAG_GNU_call_site_parameter
+        case 0x48:   // DW_TAG_call_site
+        case 0x49:   // DW_TAG_call_site_parameter
+            return false;
+
+        default:
+            return true;
+    }
+}
+
+static void setAttributes(SgAsmDwarfConstruct * c, const DwarfDie & d) {
+    c->set_name(d.name.str());
+    if(d.hasTypeRef) {
+        c->set_type_ref(refString(d.typeRef));
+    }
+    if(d.hasSpecRef) {
+        c->set_spec_ref(refString(d.specRef));
+    }
+
+    switch(c->variantT()) {
+        case V_SgAsmDwarfSubprogram: {
+            SgAsmDwarfSubprogram * s = isSgAsmDwarfSubprogram(c);
+            s->set_artificiality(d.artificial);
+            s->set_accessibility(d.accessibility);
+            s->set_virtuality(d.virtuality);
+            s->set_linkage_name(d.linkageName.str());
+            break;
+        };
+        case V_SgAsmDwarfMember: {
+            SgAsmDwarfMember * m = isSgAsmDwarfMember(c);
+            m->set_artificiality(d.artificial);
+            m->set_accessibility(d.accessibility);
+            m->set_bit_size(d.bitSize);
+            break;
+        };
+        case V_SgAsmDwarfFormalParameter:
+            isSgAsmDwarfFormalParameter(c)->set_artificiality(d.artificial);
+            break;
+        case V_SgAsmDwarfInheritance: {
+            SgAsmDwarfInheritance * i = isSgAsmDwarfInheritance(c);
+            i->set_accessibility(d.accessibility);
+            i->set_virtuality(d.virtuality);
+            break;
+        };
+        case V_SgAsmDwarfEnumerator:
+            isSgAsmDwarfEnumerator(c)->set_const_val(d.constValue);
+            break;
+        case V_SgAsmDwarfSubrangeType:
+            isSgAsmDwarfSubrangeType(c)->set_upper_bound(d.upperBound);
+            break;
+        case V_SgAsmDwarfClassType:
+            isSgAsmDwarfClassType(c)->set_linkage_name(d.linkageName.str());
+            break;
+        default: ; // Nothing else is read by the converter
+    }
+}
+
+// Creates the child list for constructs that can have one.
+static SgAsmDwarfConstructList * newChildList(SgAsmDwarfConstruct * c) {
+    SgAsmDwarfConstructList * list = new SgAsmDwarfConstructList();
+    switch(c->variantT()) {
+        case V_SgAsmDwarfCompilationUnit:
+            isSgAsmDwarfCompilationUnit(c)->set_language_constructs(list);
+            break;
+        case V_SgAsmDwarfStructureType:
+            isSgAsmDwarfStructureType(c)->set_body(list);
+            break;
+        case V_SgAsmDwarfUnionType:
+            isSgAsmDwarfUnionType(c)->set_body(list);
+            break;
+        case V_SgAsmDwarfClassType:
+            isSgAsmDwarfClassType(c)->set_body(list);
+            break;
+        case V_SgAsmDwarfEnumerationType:
+            isSgAsmDwarfEnumerationType(c)->set_body(list);
+            break;
+        case V_SgAsmDwarfNamespace:
+            isSgAsmDwarfNamespace(c)->set_body(list);
+            break;
+        case V_SgAsmDwarfSubprogram:
+            isSgAsmDwarfSubprogram(c)->set_body(list);
+            break;
+        case V_SgAsmDwarfSubroutineType:
+            isSgAsmDwarfSubroutineType(c)->set_body(list);
+            break;
+        case V_SgAsmDwarfArrayType:
+            isSgAsmDwarfArrayType(c)->set_body(list);
+            break;
+        default:
+            delete list;
+            return NULL;
+    }
+    list->set_parent(c);
+    return list;
+}
+
+SgAsmDwarfCompilationUnit * DwarfBuilder::buildUnit(const DwarfUnit & unit) {
+    if(unit.dies.empty()) {
+        return NULL;
+    }
+    const uint64_t base = unit.header.offset;
+
+    const DwarfDie & root = unit.dies[0];
+    SgAsmDwarfCompilationUnit * cu = isSgAsmDwarfCompilationUnit(
+            SgAsmDwarfConstruct::createDwarfConstruct(DW_TAG_compile_unit, 0, root.offset, base + root.offset));
+    ROSE_ASSERT(cu != NULL);
+    setAttributes(cu, root);
+
+    std::vector<SgAsmDwarfConstruct *> built(unit.dies.size(), NULL);
+    std::vector<SgAsmDwarfConstructList *> lists(unit.dies.size(), NULL);
+    std::vector<bool> listTried(unit.dies.size(), false);
+    built[0] = cu;
+
+    for(size_t i = 1; i < unit.dies.size(); ++i) {
+        const DwarfDie & die = unit.dies[i];
+        if(!shouldMaterialize(unit, die)) {
+            continue;
+        }
+
+        // Find the closest built ancestor that can hold children.
+        SgAsmDwarfConstructList * list = NULL;
+        for(uint32_t p = die.parent; p != DwarfDie::NONE && list == NULL; p = unit.dies[p].parent) {
+            if(built[p] == NULL) {
+                continue;
+            }
+            if(!listTried[p]) {
+                lists[p] = newChildList(built[p]);
+                listTried[p] = true;
+            }
+            list = lists[p];
+        }
+        if(list == NULL) {
+            continue;
+        }
+
+        SgAsmDwarfConstruct * c = SgAsmDwarfConstruct::createDwarfConstruct(die.tag, die.depth, die.offset, base + die.offset);
+        if(c == NULL) {
+            continue;
+        }
+        setAttributes(c, die);
+        list->get_list().push_back(c);
+        c->set_parent(list);
+        built[i] = c;
+    }
+
+    return cu;
+}
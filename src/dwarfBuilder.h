@@ -0,0 +1,15 @@
+#ifndef __DWARFBUILDER_H__
+#define __DWARFBUILDER_H__
+
+#include "rose.h"
+#include "dwarfReader.h"
+
+namespace DwarfBuilder {
+    // Builds the ROSE DWARF IR for a decoded compilation unit, in the same
+    // shape the ROSE binary frontend would produce. Only the constructs that
+    // UndwarfTraversal and DwarfROSE::convertType look at are materialized;
+    // local variables, lexical blocks, inlined calls and the like are not.
+    SgAsmDwarfCompilationUnit * buildUnit(const DwarfUnit & unit);
+}
+
+#endif
@@ -0,0 +1,991 @@
+#include "dwarfReader.h"
+#include "dwarf.h"
+#include "contentHash.h"
+
+#include <cstring>
+#include <iostream>
+#include <utility>
+
+// Forms and attributes added in DWARF 5, which the bundled dwarf.h predates.
+#ifndef DW_FORM_strx
+#define DW_FORM_strx                    0x1a
+#define DW_FORM_addrx                   0x1b
+#define DW_FORM_ref_sup4                0x1c
+#define DW_FORM_strp_sup                0x1d
+#define DW_FORM_data16                  0x1e
+#define DW_FORM_line_strp               0x1f
+#define DW_FORM_implicit_const          0x21
+#define DW_FORM_loclistx                0x22
+#define DW_FORM_rnglistx                0x23
+#define DW_FORM_ref_sup8                0x24
+#define DW_FORM_strx1                   0x25
+#define DW_FORM_strx2                   0x26
+#define DW_FORM_strx3                   0x27
+#define DW_FORM_strx4                   0x28
+#define DW_FORM_addrx1                  0x29
+#define DW_FORM_addrx2                  0x2a
+#define DW_FORM_addrx3                  0x2b
+#define DW_FORM_addrx4                  0x2c
+#endif
+#ifndef DW_FORM_GNU_addr_index
+#define DW_FORM_GNU_addr_index          0x1f01
+#define DW_FORM_GNU_str_index           0x1f02
+#define DW_FORM_GNU_ref_alt             0x1f20
+#define DW_FORM_GNU_strp_alt            0x1f21
+#endif
+#ifndef DW_AT_str_offsets_base
+#define DW_AT_str_offsets_base          0x72
+#endif
+#ifndef DW_UT_compile
+#define DW_UT_compile                   0x01
+#define DW_UT_type                      0x02
+#define DW_UT_partial                   0x03
+#define DW_UT_skeleton                  0x04
+#define DW_UT_split_compile             0x05
+#define DW_UT_split_type                0x06
+#endif
+#ifndef DW_LNCT_path
+#define DW_LNCT_path                    0x1
+#define DW_LNCT_directory_index         0x2
+#endif
+
+const uint32_t DwarfDie::NONE;
+
+DwarfDie::DwarfDie()
+    : offset(0), tag(0), depth(0), parent(NONE), firstChild(NONE), nextSibling(NONE),
+      typeRef(0), specRef(0), constValue(0), upperBound(0), bitSize(0), byteSize(0), memberOffset(0), bitOffset(0),
+      declFile(NONE), accessibility(0), virtuality(0), encoding(0),
+      hasTypeRef(false), hasSpecRef(false), hasUpperBound(false), hasDataBitOffset(false), hasBitOffset(false), artificial(false), declaration(false), external(false) {
+}
+
+StringRef DwarfUnit::name() const {
+    return dies.empty() ? StringRef() : dies[0].name;
+}
+
+uint32_t DwarfUnit::indexOf(uint64_t offset) const {
+    size_t lo = 0;
+    size_t hi = dies.size();
+    while(lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if(dies[mid].offset < offset) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if(lo < dies.size() && dies[lo].offset == offset) {
+        return lo;
+    }
+    return DwarfDie::NONE;
+}
+
+static void digestString(ContentHasher & hasher, const StringRef & s) {
+    // Including the terminator keeps adjacent strings apart.
+    hasher.update(s.c_str(), s.size() + 1);
+}
+
+void DwarfUnit::digest(ContentHasher & hasher) const {
+    hasher.update(header.version);
+    hasher.update(header.unitType);
+    hasher.update(header.addressSize);
+    hasher.update(header.offsetSize);
+    hasher.update(header.firstDie);
+    hasher.update(dies.size());
+    for(size_t i = 0; i < dies.size(); ++i) {
+        const DwarfDie & die = dies[i];
+        hasher.update(die.offset);
+        hasher.update(die.tag);
+        hasher.update(die.depth);
+        hasher.update(die.parent);
+        hasher.update(die.firstChild);
+        hasher.update(die.nextSibling);
+        digestString(hasher, die.name);
+        digestString(hasher, die.linkageName);
+        hasher.update(die.typeRef);
+        hasher.update(die.specRef);
+        hasher.update(die.constValue);
+        hasher.update(die.upperBound);
+        hasher.update(die.bitSize);
+        hasher.update(die.byteSize);
+        hasher.update(die.memberOffset);
+        hasher.update(die.bitOffset);
+        hasher.update(die.declFile);
+        unsigned char flags[11] = { die.accessibility, die.virtuality, die.encoding, die.hasTypeRef, die.hasSpecRef,
+            die.hasUpperBound, die.hasDataBitOffset, die.hasBitOffset, die.artificial, die.declaration, die.external };
+        hasher.update(flags, sizeof(flags));
+    }
+}
+
+namespace {
+
+// Bounds-checked sequential reader over a section. Reading past the end
+// sets the error flag and yields zeros instead of faulting.
+class Cursor {
+    public:
+        Cursor(const char * d, uint64_t s, uint64_t p = 0) : data(d), size(s), pos(p), error(false) {};
+
+        bool atEnd() const { return pos >= size; };
+        bool failed() const { return error; };
+        uint64_t offset() const { return pos; };
+        const char * here() const { return data + pos; };
+        void seek(uint64_t p) { pos = p; };
+
+        bool skip(uint64_t n) {
+            if(n > size - pos || pos > size) {
+                error = true;
+                pos = size;
+                return false;
+            }
+            pos += n;
+            return true;
+        };
+
+        uint64_t fixed(unsigned n) {
+            uint64_t v = 0;
+            if(n > size - pos || pos > size) {
+                error = true;
+                pos = size;
+                return 0;
+            }
+            // Host byte order was checked when the file was opened.
+            const uint16_t probe = 1;
+            if(*reinterpret_cast<const unsigned char *>(&probe) == 1) {
+                memcpy(&v, data + pos, n);
+            } else {
+                memcpy(reinterpret_cast<char *>(&v) + (8 - n), data + pos, n);
+            }
+            pos += n;
+            return v;
+        };
+
+        uint8_t u8() { return static_cast<uint8_t>(fixed(1)); };
+        uint16_t u16() { return static_cast<uint16_t>(fixed(2)); };
+        uint32_t u32() { return static_cast<uint32_t>(fixed(4)); };
+        uint64_t u64() { return fixed(8); };
+
+        uint64_t uleb() {
+            uint64_t result = 0;
+            unsigned shift = 0;
+            while(pos < size) {
+                uint8_t b = static_cast<uint8_t>(data[pos++]);
+                if(shift < 64) {
+                    result |= static_cast<uint64_t>(b & 0x7f) << shift;
+                }
+                shift += 7;
+                if((b & 0x80) == 0) {
+                    return result;
+                }
+            }
+            error = true;
+            return result;
+        };
+
+        int64_t sleb() {
+            int64_t result = 0;
+            unsigned shift = 0;
+            uint8_t b = 0;
+            while(pos < size) {
+                b = static_cast<uint8_t>(data[pos++]);
+                if(shift < 64) {
+                    result |= static_cast<int64_t>(b & 0x7f) << shift;
+                }
+                shift += 7;
+                if((b & 0x80) == 0) {
+                    if(shift < 64 && (b & 0x40)) {
+                        result |= -(static_cast<int64_t>(1) << shift);
+                    }
+                    return result;
+                }
+            }
+            error = true;
+            return result;
+        };
+
+        const char * cstr() {
+            const char * start = data + pos;
+            const void * end = pos < size ? memchr(start, '\0', size - pos) : NULL;
+            if(end == NULL) {
+                error = true;
+                pos = size;
+                return "";
+            }
+            pos = static_cast<const char *>(end) - data + 1;
+            return start;
+        };
+
+    private:
+        const char * data;
+        uint64_t size;
+        uint64_t pos;
+        bool error;
+};
+
+struct AttrSpec {
+    uint32_t attr;
+    uint32_t form;
+    int64_t implicitConst;
+};
+
+struct Abbrev {
+    uint32_t tag;
+    bool hasChildren;
+    std::vector<AttrSpec> attrs;
+
+    Abbrev() : tag(0), hasChildren(false) {};
+};
+
+// Abbreviation codes are almost always small and dense, so they index
+// straight into a vector.
+static const uint64_t MAX_ABBREV_CODE = 1 << 20;
+
+static bool readAbbrevTable(const SectionData & section, uint64_t offset, std::vector<Abbrev> & table) {
+    Cursor c(section.data, section.size, offset);
+    while(!c.atEnd()) {
+        uint64_t code = c.uleb();
+        if(code == 0) {
+            return true;
+        }
+        if(code > MAX_ABBREV_CODE) {
+            return false;
+        }
+        if(code >= table.size()) {
+            table.resize(code + 1);
+        }
+        Abbrev & a = table[code];
+        a.tag = c.uleb();
+        a.hasChildren = c.u8() != 0;
+        while(true) {
+            AttrSpec spec;
+            spec.attr = c.uleb();
+            spec.form = c.uleb();
+            spec.implicitConst = spec.form == DW_FORM_implicit_const ? c.sleb() : 0;
+            if(c.failed()) {
+                return false;
+            }
+            if(spec.attr == 0 && spec.form == 0) {
+                break;
+            }
+            a.attrs.push_back(spec);
+        }
+    }
+    return !table.empty();
+}
+
+enum ValueKind { VALUE_NONE, VALUE_CONSTANT, VALUE_REFERENCE, VALUE_STRING, VALUE_BLOCK, VALUE_SECTION_OFFSET };
+
+struct AttrValue {
+    ValueKind kind;
+    uint64_t u;
+    const char * str;
+    uint64_t blockSize;
+
+    AttrValue() : kind(VALUE_NONE), u(0), str(NULL), blockSize(0) {};
+};
+
+struct UnitContext {
+    const DwarfUnitHeader * header;
+    const SectionData * str;
+    const SectionData * lineStr;
+    const SectionData * strOffsets;
+    uint64_t strOffsetsBase;
+};
+
+static const char * stringAt(const SectionData & section, uint64_t offset) {
+    if(offset >= section.size) {
+        return "";
+    }
+    if(memchr(section.data + offset, '\0', section.size - offset) == NULL) {
+        return "";
+    }
+    return section.data + offset;
+}
+
+static const char * indexedString(const UnitContext & ctx, uint64_t index) {
+    const SectionData & offsets = *ctx.strOffsets;
+    uint64_t size = ctx.header->offsetSize;
+    uint64_t at = ctx.strOffsetsBase + index * size;
+    if(offsets.empty() || at + size > offsets.size) {
+        return "";
+    }
+    Cursor c(offsets.data, offsets.size, at);
+    return stringAt(*ctx.str, c.fixed(size));
+}
+
+static bool readValue(Cursor & c, uint32_t form, int64_t implicitConst, const UnitContext & ctx, AttrValue & v) {
+    const DwarfUnitHeader & h = *ctx.header;
+    switch(form) {
+        case DW_FORM_addr:
+            c.skip(h.addressSize);
+            break;
+        case DW_FORM_data1:
+        case DW_FORM_flag:
+            v.kind = VALUE_CONSTANT;
+            v.u = c.u8();
+            break;
+        case DW_FORM_data2:
+            v.kind = VALUE_CONSTANT;
+            v.u = c.u16();
+            break;
+        case DW_FORM_data4:
+            v.kind = VALUE_CONSTANT;
+            v.u = c.u32();
+            break;
+        case DW_FORM_data8:
+            v.kind = VALUE_CONSTANT;
+            v.u = c.u64();
+            break;
+        case DW_FORM_data16:
+            c.skip(16);
+            break;
+        case DW_FORM_sdata:
+            v.kind = VALUE_CONSTANT;
+            v.u = static_cast<uint64_t>(c.sleb());
+            break;
+        case DW_FORM_udata:
+            v.kind = VALUE_CONSTANT;
+            v.u = c.uleb();
+            break;
+        case DW_FORM_implicit_const:
+            v.kind = VALUE_CONSTANT;
+            v.u = static_cast<uint64_t>(implicitConst);
+            break;
+        case DW_FORM_flag_present:
+            v.kind = VALUE_CONSTANT;
+            v.u = 1;
+            break;
+
+        case DW_FORM_string:
+            v.kind = VALUE_STRING;
+            v.str = c.cstr();
+            break;
+        case DW_FORM_strp:
+            v.kind = VALUE_STRING;
+            v.str = stringAt(*ctx.str, c.fixed(h.offsetSize));
+            break;
+        case DW_FORM_line_strp:
+            v.kind = VALUE_STRING;
+            v.str = stringAt(*ctx.lineStr, c.fixed(h.offsetSize));
+            break;
+        case DW_FORM_strx:
+        case DW_FORM_GNU_str_index:
+            v.kind = VALUE_STRING;
+            v.str = indexedString(ctx, c.uleb());
+            break;
+        case DW_FORM_strx1:
+            v.kind = VALUE_STRING;
+            v.str = indexedString(ctx, c.fixed(1));
+            break;
+        case DW_FORM_strx2:
+            v.kind = VALUE_STRING;
+            v.str = indexedString(ctx, c.fixed(2));
+            break;
+        case DW_FORM_strx3:
+            v.kind = VALUE_STRING;
+            v.str = indexedString(ctx, c.fixed(3));
+            break;
+        case DW_FORM_strx4:
+            v.kind = VALUE_STRING;
+            v.str = indexedString(ctx, c.fixed(4));
+            break;
+        case DW_FORM_strp_sup:
+        case DW_FORM_GNU_strp_alt:
+            // Strings in a supplementary file we don't have.
+            c.skip(h.offsetSize);
+            break;
+
+        case DW_FORM_ref1:
+            v.kind = VALUE_REFERENCE;
+            v.u = c.u8();
+            break;
+        case DW_FORM_ref2:
+            v.kind = VALUE_REFERENCE;
+            v.u = c.u16();
+            break;
+        case DW_FORM_ref4:
+            v.kind = VALUE_REFERENCE;
+            v.u = c.u32();
+            break;
+        case DW_FORM_ref8:
+            v.kind = VALUE_REFERENCE;
+            v.u = c.u64();
+            break;
+        case DW_FORM_ref_udata:
+            v.kind = VALUE_REFERENCE;
+            v.u = c.uleb();
+            break;
+        case DW_FORM_ref_addr: {
+            // Section-relative; only usable when it points into this unit.
+            uint64_t target = c.fixed(h.version <= 2 ? h.addressSize : h.offsetSize);
+            if(target >= h.offset && target < h.offset + h.length) {
+                v.kind = VALUE_REFERENCE;
+                v.u = target - h.offset;
+            }
+            break;
+        };
+        case DW_FORM_ref_sig8:
+            c.skip(8);
+            break;
+        case DW_FORM_ref_sup4:
+            c.skip(4);
+            break;
+        case DW_FORM_ref_sup8:
+            c.skip(8);
+            break;
+        case DW_FORM_GNU_ref_alt:
+            c.skip(h.offsetSize);
+            break;
+        case DW_FORM_sec_offset:
+            v.kind = VALUE_SECTION_OFFSET;
+            v.u = c.fixed(h.offsetSize);
+            break;
+
+        case DW_FORM_block1:
+            v.kind = VALUE_BLOCK;
+            v.blockSize = c.u8();
+            break;
+        case DW_FORM_block2:
+            v.kind = VALUE_BLOCK;
+            v.blockSize = c.u16();
+            break;
+        case DW_FORM_block4:
+            v.kind = VALUE_BLOCK;
+            v.blockSize = c.u32();
+            break;
+        case DW_FORM_block:
+        case DW_FORM_exprloc:
+            v.kind = VALUE_BLOCK;
+            v.blockSize = c.uleb();
+            break;
+
+        case DW_FORM_addrx:
+        case DW_FORM_loclistx:
+        case DW_FORM_rnglistx:
+        case DW_FORM_GNU_addr_index:
+            c.uleb();
+            break;
+        case DW_FORM_addrx1:
+            c.skip(1);
+            break;
+        case DW_FORM_addrx2:
+            c.skip(2);
+            break;
+        case DW_FORM_addrx3:
+            c.skip(3);
+            break;
+        case DW_FORM_addrx4:
+            c.skip(4);
+            break;
+
+        case DW_FORM_indirect:
+            return readValue(c, c.uleb(), implicitConst, ctx, v);
+
+        default:
+            return false;
+    }
+    return !c.failed();
+}
+
+// Decodes the one-operation location expressions compilers use for
+// DW_AT_data_member_location.
+static bool memberLocation(const char * block, uint64_t size, uint64_t & out) {
+    Cursor c(block, size);
+    uint8_t op = c.u8();
+    if(op == DW_OP_plus_uconst || op == DW_OP_constu) {
+        out = c.uleb();
+        return !c.failed();
+    }
+    return false;
+}
+
+static void storeAttribute(DwarfDie & die, uint32_t attr, AttrValue & v, Cursor & c) {
+    // Blocks are only interesting for member locations; the cursor
+    // still has to skip them either way.
+    if(v.kind == VALUE_BLOCK) {
+        const char * block = c.here();
+        if(c.skip(v.blockSize) && attr == DW_AT_data_member_location) {
+            memberLocation(block, v.blockSize, die.memberOffset);
+        }
+        return;
+    }
+
+    switch(attr) {
+        case DW_AT_name:
+            if(v.kind == VALUE_STRING) {
+                die.name = StringRef(v.str);
+            }
+            break;
+        case DW_AT_linkage_name:
+        case DW_AT_MIPS_linkage_name:
+            if(v.kind == VALUE_STRING) {
+                die.linkageName = StringRef(v.str);
+            }
+            break;
+        case DW_AT_type:
+            if(v.kind == VALUE_REFERENCE) {
+                die.typeRef = v.u;
+                die.hasTypeRef = true;
+            }
+            break;
+        case DW_AT_specification:
+            if(v.kind == VALUE_REFERENCE) {
+                die.specRef = v.u;
+                die.hasSpecRef = true;
+            }
+            break;
+        case DW_AT_const_value:
+            if(v.kind == VALUE_CONSTANT) {
+                die.constValue = v.u;
+            }
+            break;
+        case DW_AT_upper_bound:
+            if(v.kind == VALUE_CONSTANT) {
+                die.upperBound = v.u;
+                die.hasUpperBound = true;
+            }
+            break;
+        case DW_AT_count:
+            if(v.kind == VALUE_CONSTANT && !die.hasUpperBound && v.u > 0) {
+                die.upperBound = v.u - 1;
+                die.hasUpperBound = true;
+            }
+            break;
+        case DW_AT_bit_size:
+            if(v.kind == VALUE_CONSTANT) {
+                die.bitSize = v.u;
+            }
+            break;
+        case DW_AT_byte_size:
+            if(v.kind == VALUE_CONSTANT) {
+                die.byteSize = v.u;
+            }
+            break;
+        case DW_AT_data_member_location:
+            if(v.kind == VALUE_CONSTANT) {
+                die.memberOffset = v.u;
+            }
+            break;
+        case DW_AT_data_bit_offset:
+            if(v.kind == VALUE_CONSTANT) {
+                die.bitOffset = v.u;
+                die.hasDataBitOffset = true;
+            }
+            break;
+        case DW_AT_bit_offset:
+            if(v.kind == VALUE_CONSTANT && !die.hasDataBitOffset) {
+                die.bitOffset = v.u;
+                die.hasBitOffset = true;
+            }
+            break;
+        case DW_AT_decl_file:
+            if(v.kind == VALUE_CONSTANT) {
+                die.declFile = v.u;
+            }
+            break;
+        case DW_AT_accessibility:
+            if(v.kind == VALUE_CONSTANT) {
+                die.accessibility = v.u;
+            }
+            break;
+        case DW_AT_virtuality:
+            if(v.kind == VALUE_CONSTANT) {
+                die.virtuality = v.u;
+            }
+            break;
+        case DW_AT_encoding:
+            if(v.kind == VALUE_CONSTANT) {
+                die.encoding = v.u;
+            }
+            break;
+        case DW_AT_artificial:
+            die.artificial = v.kind == VALUE_CONSTANT && v.u != 0;
+            break;
+        case DW_AT_declaration:
+            die.declaration = v.kind == VALUE_CONSTANT && v.u != 0;
+            break;
+        case DW_AT_external:
+            die.external = v.kind == VALUE_CONSTANT && v.u != 0;
+            break;
+        default: ; // Not needed by undwarf
+    }
+}
+
+} // namespace
+
+DwarfReader::DwarfReader(ElfFile & elf) : path(elf.path()) {
+    info = elf.sectionData(".debug_info");
+    abbrev = elf.sectionData(".debug_abbrev");
+    str = elf.sectionData(".debug_str");
+    lineStr = elf.sectionData(".debug_line_str");
+    strOffsets = elf.sectionData(".debug_str_offsets");
+    line = elf.sectionData(".debug_line");
+    scanUnits();
+}
+
+// Walk the unit headers in .debug_info without decoding any DIEs.
+void DwarfReader::scanUnits() {
+    Cursor c(info.data, info.size);
+    while(!c.atEnd()) {
+        DwarfUnitHeader h;
+        h.offset = c.offset();
+        uint64_t length = c.u32();
+        h.offsetSize = 4;
+        if(length == 0xffffffff) {
+            length = c.u64();
+            h.offsetSize = 8;
+        } else if(length >= 0xfffffff0) {
+            std::cerr << "WARNING: " << path << ": reserved unit length at offset " << h.offset << "; stopping." << std::endl;
+            return;
+        }
+        uint64_t start = c.offset();
+        h.length = (start - h.offset) + length;
+        h.version = c.u16();
+        if(h.version >= 5) {
+            h.unitType = c.u8();
+            h.addressSize = c.u8();
+            h.abbrevOffset = c.fixed(h.offsetSize);
+            // Type and skeleton units carry extra header fields.
+            switch(h.unitType) {
+                case DW_UT_skeleton:
+                case DW_UT_split_compile:
+                    c.skip(8);
+                    break;
+                case DW_UT_type:
+                case DW_UT_split_type:
+                    c.skip(8 + h.offsetSize);
+                    break;
+                default: ;
+            }
+        } else {
+            h.unitType = DW_UT_compile;
+            h.abbrevOffset = c.fixed(h.offsetSize);
+            h.addressSize = c.u8();
+        }
+        h.firstDie = c.offset() - h.offset;
+
+        if(c.failed() || length > info.size - start || h.version < 2 || h.version > 5) {
+            std::cerr << "WARNING: " << path << ": malformed unit header at offset " << h.offset << "; stopping." << std::endl;
+            return;
+        }
+        if(h.unitType == DW_UT_compile || h.unitType == DW_UT_partial) {
+            unitHeaders.push_back(h);
+        }
+        c.seek(start + length);
+    }
+}
+
+SectionData DwarfReader::unitData(const DwarfUnitHeader & header) const {
+    return SectionData(info.data + header.offset, header.length);
+}
+
+// The unit DIE's DW_AT_str_offsets_base, or base if it has none. Clang
+// puts the attribute after DW_AT_producer and DW_AT_name, which already
+// use it, so it has to be found before any attribute is read for real.
+static uint64_t strOffsetsBase(Cursor c, const std::vector<Abbrev> & abbrevs, const UnitContext & ctx, uint64_t base) {
+    uint64_t code = c.uleb();
+    if(code == 0 || code >= abbrevs.size() || abbrevs[code].tag == 0) {
+        return base;
+    }
+    const Abbrev & a = abbrevs[code];
+    for(size_t i = 0; i < a.attrs.size(); ++i) {
+        AttrValue v;
+        if(!readValue(c, a.attrs[i].form, a.attrs[i].implicitConst, ctx, v)) {
+            return base;
+        }
+        if(a.attrs[i].attr == DW_AT_str_offsets_base && (v.kind == VALUE_CONSTANT || v.kind == VALUE_SECTION_OFFSET)) {
+            return v.u;
+        }
+        if(v.kind == VALUE_BLOCK && !c.skip(v.blockSize)) {
+            return base;
+        }
+    }
+    return base;
+}
+
+// The size of a fixed-size data form, 0 for any other.
+static unsigned dataSize(uint32_t form) {
+    switch(form) {
+        case DW_FORM_data1:
+            return 1;
+        case DW_FORM_data2:
+            return 2;
+        case DW_FORM_data4:
+            return 4;
+        default:
+            return 0;
+    }
+}
+
+// Whether the type at offset is a signed integer, looking through
+// typedefs and qualifiers.
+static bool isSignedType(const DwarfUnit & unit, uint64_t offset) {
+    for(int hops = 0; hops < 16; ++hops) {
+        uint32_t i = unit.indexOf(offset);
+        if(i == DwarfDie::NONE) {
+            return false;
+        }
+        const DwarfDie & d = unit.dies[i];
+        if(d.tag == DW_TAG_base_type) {
+            return d.encoding == DW_ATE_signed || d.encoding == DW_ATE_signed_char;
+        }
+        if((d.tag != DW_TAG_typedef && d.tag != DW_TAG_const_type && d.tag != DW_TAG_volatile_type) || !d.hasTypeRef) {
+            return false;
+        }
+        offset = d.typeRef;
+    }
+    return false;
+}
+
+// Fixed-size data forms have no sign; the values of the enumerators
+// given in them are sign-extended when the enumeration's underlying
+// type is signed, so NEG = -3 isn't read as 253.
+static void signExtendEnumerators(DwarfUnit & unit, const std::vector<std::pair<uint32_t, unsigned> > & narrow) {
+    for(size_t k = 0; k < narrow.size(); ++k) {
+        DwarfDie & d = unit.dies[narrow[k].first];
+        if(d.tag != DW_TAG_enumerator || d.parent == DwarfDie::NONE) {
+            continue;
+        }
+        const DwarfDie & e = unit.dies[d.parent];
+        if(e.tag != DW_TAG_enumeration_type || !e.hasTypeRef || !isSignedType(unit, e.typeRef)) {
+            continue;
+        }
+        unsigned shift = 64 - 8 * narrow[k].second;
+        d.constValue = static_cast<uint64_t>(static_cast<int64_t>(d.constValue << shift) >> shift);
+    }
+}
+
+bool DwarfReader::readUnit(const DwarfUnitHeader & header, DwarfUnit & unit) const {
+    unit.header = header;
+    unit.dies.clear();
+    unit.lineOffset = 0;
+    unit.hasLineTable = false;
+    unit.compDir = StringRef();
+
+    std::vector<Abbrev> abbrevs;
+    if(!readAbbrevTable(abbrev, header.abbrevOffset, abbrevs)) {
+        std::cerr << "WARNING: " << path << ": bad abbreviation table for unit at offset " << header.offset << std::endl;
+        return false;
+    }
+
+    UnitContext ctx;
+    ctx.header = &header;
+    ctx.str = &str;
+    ctx.lineStr = &lineStr;
+    ctx.strOffsets = &strOffsets;
+    ctx.strOffsetsBase = header.offsetSize == 4 ? 8 : 16;
+
+    // Only the unit's own bytes are visible to the cursor.
+    Cursor c(info.data + header.offset, header.length, header.firstDie);
+    ctx.strOffsetsBase = strOffsetsBase(c, abbrevs, ctx, ctx.strOffsetsBase);
+    std::vector<uint32_t> parents;
+    std::vector<uint32_t> lastChild;
+    uint32_t previousTopLevel = DwarfDie::NONE;
+    // DW_AT_const_value attributes in fixed-size forms, and their size
+    std::vector<std::pair<uint32_t, unsigned> > narrow;
+
+    while(!c.atEnd()) {
+        uint64_t offset = c.offset();
+        uint64_t code = c.uleb();
+        if(code == 0) {
+            // End of a sibling chain.
+            if(parents.empty()) {
+                continue;
+            }
+            parents.pop_back();
+            lastChild.pop_back();
+            continue;
+        }
+        if(code >= abbrevs.size() || abbrevs[code].tag == 0) {
+            std::cerr << "WARNING: " << path << ": unknown abbreviation " << code << " at offset " << offset
+                << " in unit at offset " << header.offset << std::endl;
+            return false;
+        }
+        const Abbrev & a = abbrevs[code];
+
+        uint32_t index = unit.dies.size();
+        unit.dies.push_back(DwarfDie());
+        DwarfDie & die = unit.dies.back();
+        die.offset = offset;
+        die.tag = a.tag;
+        die.depth = parents.size();
+
+        for(size_t i = 0; i < a.attrs.size(); ++i) {
+            AttrValue v;
+            if(!readValue(c, a.attrs[i].form, a.attrs[i].implicitConst, ctx, v)) {
+                std::cerr << "WARNING: " << path << ": bad attribute form " << a.attrs[i].form << " at offset " << offset
+                    << " in unit at offset " << header.offset << std::endl;
+                return false;
+            }
+            bool sectionOffset = v.kind == VALUE_CONSTANT || v.kind == VALUE_SECTION_OFFSET;
+            if(index == 0 && a.attrs[i].attr == DW_AT_stmt_list && sectionOffset) {
+                unit.lineOffset = v.u;
+                unit.hasLineTable = true;
+            }
+            if(index == 0 && a.attrs[i].attr == DW_AT_comp_dir && v.kind == VALUE_STRING) {
+                unit.compDir = StringRef(v.str);
+            }
+            if(a.attrs[i].attr == DW_AT_const_value && v.kind == VALUE_CONSTANT && dataSize(a.attrs[i].form) > 0) {
+                narrow.push_back(std::make_pair(index, dataSize(a.attrs[i].form)));
+            }
+            storeAttribute(die, a.attrs[i].attr, v, c);
+        }
+
+        if(parents.empty()) {
+            if(previousTopLevel != DwarfDie::NONE) {
+                unit.dies[previousTopLevel].nextSibling = index;
+            }
+            previousTopLevel = index;
+        } else {
+            die.parent = parents.back();
+            if(lastChild.back() == DwarfDie::NONE) {
+                unit.dies[die.parent].firstChild = index;
+            } else {
+                unit.dies[lastChild.back()].nextSibling = index;
+            }
+            lastChild.back() = index;
+        }
+
+        if(a.hasChildren) {
+            parents.push_back(index);
+            lastChild.push_back(DwarfDie::NONE);
+        }
+    }
+    signExtendEnumerators(unit, narrow);
+    return !c.failed();
+}
+
+static std::string joinPath(const std::string & directory, const char * name) {
+    if(name[0] == '/' || directory.empty()) {
+        return name;
+    }
+    if(directory[directory.size() - 1] == '/') {
+        return directory + name;
+    }
+    return directory + "/" + name;
+}
+
+namespace {
+
+struct EntryFormat {
+    uint32_t content;
+    uint32_t form;
+};
+
+// Reads a DWARF 5 directory or file name table: the entry formats, then
+// the entries, keeping each entry's path and directory index.
+bool readEntryTable(Cursor & c, const UnitContext & ctx, std::vector<std::pair<const char *, uint64_t> > & entries) {
+    std::vector<EntryFormat> formats(c.u8());
+    for(size_t i = 0; i < formats.size(); ++i) {
+        formats[i].content = c.uleb();
+        formats[i].form = c.uleb();
+    }
+    uint64_t count = c.uleb();
+    for(uint64_t n = 0; n < count && !c.failed(); ++n) {
+        std::pair<const char *, uint64_t> entry("", 0);
+        for(size_t i = 0; i < formats.size(); ++i) {
+            AttrValue v;
+            if(!readValue(c, formats[i].form, 0, ctx, v)) {
+                return false;
+            }
+            if(v.kind == VALUE_BLOCK) {
+                c.skip(v.blockSize);
+            }
+            if(formats[i].content == DW_LNCT_path && v.kind == VALUE_STRING) {
+                entry.first = v.str;
+            } else if(formats[i].content == DW_LNCT_directory_index && v.kind == VALUE_CONSTANT) {
+                entry.second = v.u;
+            }
+        }
+        entries.push_back(entry);
+    }
+    return !c.failed();
+}
+
+} // namespace
+
+bool DwarfReader::fileNames(const DwarfUnit & unit, std::vector<std::string> & names) const {
+    names.clear();
+    if(!unit.hasLineTable || unit.lineOffset >= line.size) {
+        return false;
+    }
+    Cursor c(line.data, line.size, unit.lineOffset);
+    DwarfUnitHeader h = unit.header;
+    uint64_t length = c.u32();
+    h.offsetSize = 4;
+    if(length == 0xffffffff) {
+        length = c.u64();
+        h.offsetSize = 8;
+    }
+    h.version = c.u16();
+    if(h.version >= 5) {
+        h.addressSize = c.u8();
+        c.u8();     // segment selector size
+    }
+    uint64_t headerLength = c.fixed(h.offsetSize);
+    uint64_t programStart = c.offset() + headerLength;
+    c.u8();         // minimum instruction length
+    if(h.version >= 4) {
+        c.u8();     // maximum operations per instruction
+    }
+    c.u8();         // default is_stmt
+    c.u8();         // line base
+    c.u8();         // line range
+    uint8_t opcodeBase = c.u8();
+    c.skip(opcodeBase > 0 ? opcodeBase - 1 : 0);
+    if(c.failed() || h.version < 2 || h.version > 5 || programStart > line.size) {
+        std::cerr << "WARNING: " << path << ": malformed line table at offset " << unit.lineOffset << std::endl;
+        return false;
+    }
+
+    UnitContext ctx;
+    ctx.header = &h;
+    ctx.str = &str;
+    ctx.lineStr = &lineStr;
+    ctx.strOffsets = &strOffsets;
+    ctx.strOffsetsBase = 0;
+
+    std::string compDir = unit.compDir.str();
+    std::vector<std::string> directories;
+    std::vector<std::pair<const char *, uint64_t> > files;
+    if(h.version >= 5) {
+        // Directory 0 and file 0 are the unit's own.
+        std::vector<std::pair<const char *, uint64_t> > entries;
+        if(!readEntryTable(c, ctx, entries) || !readEntryTable(c, ctx, files)) {
+            std::cerr << "WARNING: " << path << ": malformed line table at offset " << unit.lineOffset << std::endl;
+            return false;
+        }
+        for(size_t i = 0; i < entries.size(); ++i) {
+            directories.push_back(joinPath(compDir, entries[i].first));
+        }
+    } else {
+        // Directory 0 is the compilation directory, and file numbers start
+        // at 1.
+        directories.push_back(compDir);
+        while(true) {
+            const char * directory = c.cstr();
+            if(c.failed() || *directory == '\0') {
+                break;
+            }
+            directories.push_back(joinPath(compDir, directory));
+        }
+        files.push_back(std::make_pair("", 0));
+        while(true) {
+            const char * name = c.cstr();
+            if(c.failed() || *name == '\0') {
+                break;
+            }
+            uint64_t directory = c.uleb();
+            c.uleb();   // modification time
+            c.uleb();   // length
+            files.push_back(std::make_pair(name, directory));
+        }
+    }
+
+    names.resize(files.size());
+    for(size_t i = 0; i < files.size(); ++i) {
+        if(*files[i].first != '\0') {
+            const std::string & directory = files[i].second < directories.size() ? directories[files[i].second] : compDir;
+            names[i] = joinPath(directory, files[i].first);
+        }
+    }
+    return !c.failed();
+}
@@ -0,0 +1,133 @@
+#ifndef __DWARFREADER_H__
+#define __DWARFREADER_H__
+
+// Reads .debug_info/.debug_abbrev/.debug_str directly out of an ELF file.
+// Compilation units are decoded one at a time into flat DwarfDie records
+// that keep only the attributes undwarf uses.
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "elfFile.h"
+#include "stringRef.h"
+
+class ContentHasher;
+
+// A decoded debugging information entry. Offsets (including the
+// type and specification references) are relative to the start of the
+// containing compilation unit, which is what ROSE reports as well.
+// Strings point into the mapped debug sections and are never copied.
+struct DwarfDie {
+    static const uint32_t NONE = 0xffffffff;
+
+    uint64_t offset;
+    uint32_t tag;
+    uint32_t depth;
+
+    // Indices into DwarfUnit::dies
+    uint32_t parent;
+    uint32_t firstChild;
+    uint32_t nextSibling;
+
+    StringRef name;
+    StringRef linkageName;
+
+    uint64_t typeRef;
+    uint64_t specRef;
+    uint64_t constValue;
+    uint64_t upperBound;
+    uint64_t bitSize;
+    uint64_t byteSize;
+    uint64_t memberOffset;
+    // A bit-field's DW_AT_data_bit_offset, or DWARF 2/3's DW_AT_bit_offset,
+    // which counts from the most significant bit of its storage unit.
+    uint64_t bitOffset;
+    uint32_t declFile;      // NONE without DW_AT_decl_file
+    uint8_t accessibility;
+    uint8_t virtuality;
+    uint8_t encoding;       // DW_AT_encoding of a base type
+
+    bool hasTypeRef;
+    bool hasSpecRef;
+    bool hasUpperBound;
+    bool hasDataBitOffset;
+    bool hasBitOffset;
+    bool artificial;
+    bool declaration;
+    bool external;
+
+    DwarfDie();
+};
+
+struct DwarfUnitHeader {
+    uint64_t offset;        // Offset of the unit header in .debug_info
+    uint64_t length;        // Size of the unit including its header
+    uint64_t abbrevOffset;
+    uint64_t firstDie;      // Offset of the first DIE, relative to the unit
+    uint16_t version;
+    uint8_t unitType;
+    uint8_t addressSize;
+    uint8_t offsetSize;     // 4 for 32-bit DWARF, 8 for 64-bit DWARF
+};
+
+class DwarfUnit {
+    public:
+        DwarfUnitHeader header;
+        // In .debug_info order, so sorted by offset.
+        std::vector<DwarfDie> dies;
+        // The unit's DW_AT_stmt_list and DW_AT_comp_dir, which locate the
+        // file names that DwarfDie::declFile indexes.
+        uint64_t lineOffset;
+        bool hasLineTable;
+        StringRef compDir;
+
+        DwarfUnit() : lineOffset(0), hasLineTable(false) {};
+
+        const DwarfDie * root() const { return dies.empty() ? NULL : &dies[0]; };
+        StringRef name() const;
+        uint32_t indexOf(uint64_t offset) const;
+
+        // Hashes everything the DIE records hold, with strings by content
+        // and offsets relative to the unit, so the same unit gives the same
+        // digest wherever it ends up in .debug_info and whatever the string
+        // and abbreviation tables around it look like.
+        void digest(ContentHasher & hasher) const;
+};
+
+class DwarfReader {
+    public:
+        explicit DwarfReader(ElfFile & elf);
+
+        // True if the file has any DWARF debug information.
+        bool valid() const { return !info.empty() && !abbrev.empty(); };
+
+        const std::vector<DwarfUnitHeader> & units() const { return unitHeaders; };
+
+        // Decodes every DIE of the unit. Returns false on malformed input;
+        // whatever was decoded up to that point is kept.
+        bool readUnit(const DwarfUnitHeader & header, DwarfUnit & unit) const;
+
+        // The raw .debug_info bytes of a unit.
+        SectionData unitData(const DwarfUnitHeader & header) const;
+
+        // The paths of the source files in the unit's line table, indexed
+        // like DwarfDie::declFile; relative names are joined with their
+        // directory and the unit's compilation directory. Entries the unit
+        // doesn't have are left empty. Returns false if the line table
+        // can't be read.
+        bool fileNames(const DwarfUnit & unit, std::vector<std::string> & names) const;
+
+    private:
+        SectionData info;
+        SectionData abbrev;
+        SectionData str;
+        SectionData lineStr;
+        SectionData strOffsets;
+        SectionData line;
+        std::string path;
+        std::vector<DwarfUnitHeader> unitHeaders;
+
+        void scanUnits();
+};
+
+#endif
@@ -0,0 +1,233 @@
+#include "elfFile.h"
+
+#include <elf.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+ElfFile::ElfFile() : fd(-1), is64(false), map(NULL), mapSize(0) {
+}
+
+ElfFile::~ElfFile() {
+    if(map != NULL) {
+        munmap(const_cast<char *>(map), mapSize);
+    }
+    if(fd >= 0) {
+        close(fd);
+    }
+}
+
+bool ElfFile::readAt(uint64_t offset, void * buf, uint64_t size) const {
+    char * out = static_cast<char *>(buf);
+    while(size > 0) {
+        ssize_t n = pread(fd, out, size, offset);
+        if(n <= 0) {
+            return false;
+        }
+        out += n;
+        offset += n;
+        size -= n;
+    }
+    return true;
+}
+
+template <class Ehdr, class Shdr>
+bool ElfFile::readSectionHeaders() {
+    Ehdr ehdr;
+    if(!readAt(0, &ehdr, sizeof(ehdr))) {
+        std::cerr << "ERROR: " << filePath << ": truncated ELF header." << std::endl;
+        return false;
+    }
+    if(ehdr.e_shoff == 0 || ehdr.e_shentsize != sizeof(Shdr)) {
+        std::cerr << "ERROR: " << filePath << ": no usable section header table." << std::endl;
+        return false;
+    }
+
+    // Section 0 holds the real count and string table index when they
+    // don't fit in the ELF header.
+    Shdr first;
+    if(!readAt(ehdr.e_shoff, &first, sizeof(first))) {
+        std::cerr << "ERROR: " << filePath << ": truncated section header table." << std::endl;
+        return false;
+    }
+    uint64_t count = ehdr.e_shnum == 0 ? first.sh_size : ehdr.e_shnum;
+    uint32_t strIndex = ehdr.e_shstrndx == SHN_XINDEX ? first.sh_link : ehdr.e_shstrndx;
+
+    std::vector<Shdr> headers(count);
+    if(count == 0 || !readAt(ehdr.e_shoff, &headers[0], count * sizeof(Shdr))) {
+        std::cerr << "ERROR: " << filePath << ": truncated section header table." << std::endl;
+        return false;
+    }
+    if(strIndex >= count) {
+        std::cerr << "ERROR: " << filePath << ": bad section name table index." << std::endl;
+        return false;
+    }
+
+    std::vector<char> names(headers[strIndex].sh_size + 1, '\0');
+    if(!readAt(headers[strIndex].sh_offset, &names[0], headers[strIndex].sh_size)) {
+        std::cerr << "ERROR: " << filePath << ": truncated section name table." << std::endl;
+        return false;
+    }
+
+    sectionList.resize(count);
+    for(uint64_t i = 0; i < count; ++i) {
+        Section & s = sectionList[i];
+        const Shdr & h = headers[i];
+        s.name = h.sh_name < names.size() ? &names[h.sh_name] : "";
+        s.type = h.sh_type;
+        s.flags = h.sh_flags;
+        s.offset = h.sh_offset;
+        s.size = h.sh_type == SHT_NOBITS ? 0 : h.sh_size;
+        s.link = h.sh_link;
+        s.entsize = h.sh_entsize;
+    }
+    sectionCache.assign(count, SectionData());
+    return true;
+}
+
+bool ElfFile::open(const std::string & path) {
+    filePath = path;
+    fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0) {
+        std::cerr << "ERROR: Unable to open " << path << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    unsigned char ident[EI_NIDENT];
+    if(!readAt(0, ident, EI_NIDENT) || memcmp(ident, ELFMAG, SELFMAG) != 0) {
+        std::cerr << "ERROR: " << path << " is not an ELF file." << std::endl;
+        return false;
+    }
+
+    // Section contents are read in host byte order.
+    const uint16_t probe = 1;
+    const unsigned char hostData = *reinterpret_cast<const unsigned char *>(&probe) == 1 ? ELFDATA2LSB : ELFDATA2MSB;
+    if(ident[EI_DATA] != hostData) {
+        std::cerr << "ERROR: " << path << " has a different byte order than this host." << std::endl;
+        return false;
+    }
+
+    // Sections are served from a read-only mapping of the whole file, so
+    // nothing is copied and untouched debug data is never read in. Fall
+    // back to reading sections if the mapping fails (e.g. no address
+    // space on a 32-bit host).
+    struct stat st;
+    if(fstat(fd, &st) == 0 && st.st_size > 0) {
+        void * p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(p != MAP_FAILED) {
+            map = static_cast<const char *>(p);
+            mapSize = st.st_size;
+        }
+    }
+
+    is64 = ident[EI_CLASS] == ELFCLASS64;
+    switch(ident[EI_CLASS]) {
+        case ELFCLASS32:
+            return readSectionHeaders<Elf32_Ehdr, Elf32_Shdr>();
+        case ELFCLASS64:
+            return readSectionHeaders<Elf64_Ehdr, Elf64_Shdr>();
+        default:
+            std::cerr << "ERROR: " << path << " has an unknown ELF class." << std::endl;
+            return false;
+    }
+}
+
+const ElfFile::Section * ElfFile::findSection(const std::string & name) const {
+    for(size_t i = 0; i < sectionList.size(); ++i) {
+        if(sectionList[i].name == name) {
+            return &sectionList[i];
+        }
+    }
+    return NULL;
+}
+
+SectionData ElfFile::sectionData(const std::string & name) {
+    const Section * s = findSection(name);
+    if(s == NULL || s->size == 0) {
+        return SectionData();
+    }
+    size_t index = s - &sectionList[0];
+    if(sectionCache[index].data != NULL) {
+        return sectionCache[index];
+    }
+#ifdef SHF_COMPRESSED
+    if(s->flags & SHF_COMPRESSED) {
+        std::cerr << "WARNING: " << filePath << ": section " << name << " is compressed; ignoring it." << std::endl;
+        return SectionData();
+    }
+#endif
+
+    if(map != NULL) {
+        if(s->offset > mapSize || s->size > mapSize - s->offset) {
+            std::cerr << "WARNING: " << filePath << ": section " << name << " is truncated; ignoring it." << std::endl;
+            return SectionData();
+        }
+        sectionCache[index] = SectionData(map + s->offset, s->size);
+        return sectionCache[index];
+    }
+
+    loaded.push_back(std::vector<char>(s->size));
+    std::vector<char> & buf = loaded.back();
+    if(!readAt(s->offset, &buf[0], s->size)) {
+        std::cerr << "WARNING: " << filePath << ": section " << name << " is truncated; ignoring it." << std::endl;
+        loaded.pop_back();
+        return SectionData();
+    }
+    sectionCache[index] = SectionData(&buf[0], buf.size());
+    return sectionCache[index];
+}
+
+void ElfFile::release(const char * data, uint64_t size) const {
+    if(map == NULL || data < map || data + size > map + mapSize) {
+        return;
+    }
+    // Only whole pages inside the range can be dropped.
+    const uintptr_t page = sysconf(_SC_PAGESIZE);
+    uintptr_t start = (reinterpret_cast<uintptr_t>(data) + page - 1) & ~(page - 1);
+    uintptr_t end = (reinterpret_cast<uintptr_t>(data) + size) & ~(page - 1);
+    if(end > start) {
+        madvise(reinterpret_cast<void *>(start), end - start, MADV_DONTNEED);
+    }
+}
+
+template <class Sym>
+void ElfFile::readExports(const SectionData & symbols, const SectionData & names, std::vector<std::string> & exports) const {
+    // Entry 0 is always the undefined symbol.
+    for(uint64_t at = sizeof(Sym); at + sizeof(Sym) <= symbols.size; at += sizeof(Sym)) {
+        Sym sym;
+        memcpy(&sym, symbols.data + at, sizeof(sym));
+        unsigned char binding = sym.st_info >> 4;
+        unsigned char type = sym.st_info & 0xf;
+        if(sym.st_shndx == SHN_UNDEF || sym.st_shndx == SHN_ABS || (binding != STB_GLOBAL && binding != STB_WEAK)
+                || type != STT_FUNC || sym.st_name >= names.size) {
+            continue;
+        }
+        const char * name = names.data + sym.st_name;
+        if(memchr(name, '\0', names.size - sym.st_name) != NULL) {
+            exports.push_back(name);
+        }
+    }
+}
+
+std::vector<std::string> ElfFile::exportedSymbols() {
+    std::vector<std::string> exports;
+    const Section * dynsym = findSection(".dynsym");
+    if(dynsym == NULL || dynsym->link >= sectionList.size()) {
+        return exports;
+    }
+    SectionData symbols = sectionData(".dynsym");
+    SectionData names = sectionData(sectionList[dynsym->link].name);
+    if(symbols.empty() || names.empty()) {
+        return exports;
+    }
+    if(is64) {
+        readExports<Elf64_Sym>(symbols, names, exports);
+    } else {
+        readExports<Elf32_Sym>(symbols, names, exports);
+    }
+    return exports;
+}
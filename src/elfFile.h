@@ -0,0 +1,79 @@
+#ifndef __ELFFILE_H__
+#define __ELFFILE_H__
+
+// Minimal ELF section loader. Only knows enough about ELF to locate
+// sections by name and hand their contents to the DWARF reader, so that
+// undwarf can read debug information without going through the ROSE
+// binary frontend. The file is mapped read-only and section contents are
+// served straight out of the mapping.
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <list>
+
+struct SectionData {
+    const char * data;
+    uint64_t size;
+
+    SectionData(const char * d = NULL, uint64_t s = 0) : data(d), size(s) {};
+    bool empty() const { return data == NULL || size == 0; };
+};
+
+class ElfFile {
+    public:
+        struct Section {
+            std::string name;
+            uint32_t type;
+            uint64_t flags;
+            uint64_t offset;
+            uint64_t size;
+            uint32_t link;
+            uint64_t entsize;
+        };
+
+        ElfFile();
+        ~ElfFile();
+
+        // Reads the ELF and section headers of the file at path.
+        // Returns false (and prints a message) if it isn't a usable ELF file.
+        bool open(const std::string & path);
+
+        const std::string & path() const { return filePath; };
+        const std::vector<Section> & sections() const { return sectionList; };
+        const Section * findSection(const std::string & name) const;
+
+        // Returns the contents of the named section. The data stays valid
+        // for the lifetime of the ElfFile. Missing sections are empty.
+        SectionData sectionData(const std::string & name);
+
+        // Tells the kernel a range of section data won't be needed again
+        // soon, so its pages stop counting against our resident set.
+        // They are simply read back in if they are touched later.
+        void release(const char * data, uint64_t size) const;
+
+        // Names of the functions the file exports: the defined global
+        // and weak functions of .dynsym.
+        std::vector<std::string> exportedSymbols();
+
+    private:
+        std::string filePath;
+        int fd;
+        bool is64;
+        const char * map;
+        uint64_t mapSize;
+        std::vector<Section> sectionList;
+        // Only used if the file couldn't be mapped.
+        std::list<std::vector<char> > loaded;
+        std::vector<SectionData> sectionCache;
+
+        bool readAt(uint64_t offset, void * buf, uint64_t size) const;
+        template <class Ehdr, class Shdr> bool readSectionHeaders();
+        template <class Sym> void readExports(const SectionData & symbols, const SectionData & names,
+                std::vector<std::string> & exports) const;
+
+        ElfFile(ElfFile const &);
+        void operator=(ElfFile const &);
+};
+
+#endif
@@ -0,0 +1,81 @@
+#include "fileWatcher.h"
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+
+FileWatcher::FileWatcher(const std::vector<std::string> & paths) : fd(inotify_init()) {
+    if(fd < 0) {
+        std::cerr << "ERROR: Could not start watching files: " << strerror(errno) << std::endl;
+        return;
+    }
+    for(size_t i = 0; i < paths.size(); ++i) {
+        size_t slash = paths[i].rfind('/');
+        std::string directory = slash == std::string::npos ? "." : slash == 0 ? "/" : paths[i].substr(0, slash);
+        std::string name = slash == std::string::npos ? paths[i] : paths[i].substr(slash + 1);
+        int wd = inotify_add_watch(fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+        if(wd < 0) {
+            std::cerr << "ERROR: Could not watch " << directory << ": " << strerror(errno) << std::endl;
+            close(fd);
+            fd = -1;
+            return;
+        }
+        files[wd].insert(name);
+    }
+}
+
+FileWatcher::~FileWatcher() {
+    if(fd >= 0) {
+        close(fd);
+    }
+}
+
+bool FileWatcher::readEvents(bool & changed) {
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t size = read(fd, buffer, sizeof(buffer));
+    if(size < 0) {
+        return errno == EINTR;
+    }
+    for(char * p = buffer; p < buffer + size; ) {
+        const struct inotify_event * event = reinterpret_cast<const struct inotify_event *>(p);
+        if(event->len > 0) {
+            std::map<int, std::set<std::string> >::const_iterator it = files.find(event->wd);
+            if(it != files.end() && it->second.count(event->name) > 0) {
+                changed = true;
+            }
+        }
+        p += sizeof(struct inotify_event) + event->len;
+    }
+    return true;
+}
+
+bool FileWatcher::wait(int settle) {
+    bool changed = false;
+    while(!changed) {
+        if(!readEvents(changed)) {
+            std::cerr << "ERROR: Could not read file events: " << strerror(errno) << std::endl;
+            return false;
+        }
+    }
+
+    struct pollfd p;
+    p.fd = fd;
+    p.events = POLLIN;
+    while(true) {
+        p.revents = 0;
+        int ready = poll(&p, 1, settle);
+        if(ready < 0 && errno != EINTR) {
+            std::cerr << "ERROR: Could not wait for file events: " << strerror(errno) << std::endl;
+            return false;
+        }
+        if(ready == 0) {
+            return true;
+        }
+        if(ready > 0 && !readEvents(changed)) {
+            std::cerr << "ERROR: Could not read file events: " << strerror(errno) << std::endl;
+            return false;
+        }
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef __FILEWATCHER_H__
+#define __FILEWATCHER_H__
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+// Waits for files to change, using inotify. The directories holding the
+// files are watched rather than the files themselves, so a file that is
+// replaced (linkers often write a new file and rename it over the old
+// one) is noticed as well as one that is rewritten in place.
+class FileWatcher {
+    public:
+        explicit FileWatcher(const std::vector<std::string> & paths);
+        ~FileWatcher();
+
+        bool valid() const { return fd >= 0; };
+
+        // Blocks until one of the files was written or replaced, then
+        // until their directories have been quiet for settle milliseconds,
+        // so a file still being written isn't read half-way. False on error.
+        bool wait(int settle);
+
+    private:
+        int fd;
+        // Watch descriptor to the names of the files in that directory
+        std::map<int, std::set<std::string> > files;
+
+        // Reads the pending events; sets changed if any was for a file.
+        bool readEvents(bool & changed);
+
+        FileWatcher(FileWatcher const &);
+        void operator=(FileWatcher const &);
+};
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef __FORWARDDECLARATIONS_H__
+#define __FORWARDDECLARATIONS_H__
+
+#include "rose.h"
+#include <string>
+#include <utility>
+#include <boost/unordered_map.hpp>
+
+// The forward declaration of each class, structure and union, by scope
+// and name. A compilation unit can describe one record with several DIEs
+// (a declaration here, the definition there), and each of them used to
+// get its own forward declaration and its own placed declaration; with
+// this they all share the first ones made.
+class ForwardDeclarations {
+    public:
+        struct Record {
+            // Placed at the front of the scope
+            SgClassDeclaration * forward;
+            // Placed where the record was first needed, or NULL if it
+            // has only been declared
+            SgClassDeclaration * decl;
+            // Whether decl is the definition, with members to fill in
+            bool defined;
+
+            Record() : forward(NULL), decl(NULL), defined(false) {};
+        };
+
+        ForwardDeclarations() : reuseCount(0) {};
+
+        // The record called name in scope; its forward declaration is
+        // NULL if it hasn't been declared yet.
+        Record & lookup(SgScopeStatement * scope, const std::string & name) {
+            Record & r = records[std::make_pair(scope, name)];
+            if(r.forward != NULL) {
+                ++reuseCount;
+            }
+            return r;
+        };
+
+        // How many declarations were saved by finding one already made.
+        size_t reused() const { return reuseCount; };
+
+    private:
+        boost::unordered_map<std::pair<SgScopeStatement *, std::string>, Record> records;
+        size_t reuseCount;
+};
+
+#endif
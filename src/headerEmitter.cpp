@@ -0,0 +1,365 @@
+#include "headerEmitter.h"
+#include "rose.h"
+#include <boost/foreach.hpp>
+
+// Names ROSE's unparser uses for the fundamental types; empty for
+// anything that isn't one.
+static const char * fundamentalName(VariantT v) {
+    switch(v) {
+        case V_SgTypeBool:              return "bool";
+        case V_SgTypeChar:              return "char";
+        case V_SgTypeDouble:            return "double";
+        case V_SgTypeFloat:             return "float";
+        case V_SgTypeInt:               return "int";
+        case V_SgTypeLong:              return "long";
+        case V_SgTypeLongDouble:        return "long double";
+        case V_SgTypeLongLong:          return "long long";
+        case V_SgTypeShort:             return "short";
+        case V_SgTypeVoid:              return "void";
+        case V_SgTypeWchar:             return "wchar_t";
+        case V_SgTypeSignedChar:        return "signed char";
+        case V_SgTypeSignedInt:         return "signed int";
+        case V_SgTypeSignedLong:        return "signed long";
+        case V_SgTypeSignedLongLong:    return "signed long long";
+        case V_SgTypeSignedShort:       return "signed short";
+        case V_SgTypeUnsignedChar:      return "unsigned char";
+        case V_SgTypeUnsignedInt:       return "unsigned int";
+        case V_SgTypeUnsignedLong:      return "unsigned long";
+        case V_SgTypeUnsignedLongLong:  return "unsigned long long";
+        case V_SgTypeUnsignedShort:     return "unsigned short";
+        default:                        return "";
+    }
+}
+
+// True if a name declared in inner can be written unqualified in scope.
+static bool isVisibleFrom(SgScopeStatement * inner, SgScopeStatement * scope) {
+    if(inner == NULL || isSgGlobal(inner)) {
+        return true;
+    }
+    for(SgScopeStatement * s = scope; s != NULL && !isSgGlobal(s); s = s->get_scope()) {
+        if(s == inner) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void HeaderEmitter::indent() {
+    out.append(depth * 2, ' ');
+}
+
+void HeaderEmitter::emitComments(SgLocatedNode * n, PreprocessingInfo::RelativePositionType position) {
+    AttachedPreprocessingInfoType * infos = n->getAttachedPreprocessingInfo();
+    if(infos == NULL) {
+        return;
+    }
+    BOOST_FOREACH(PreprocessingInfo * info, *infos) {
+        if(info->getRelativePosition() == position) {
+            indent();
+            out += info->getString();
+            out += '\n';
+        }
+    }
+}
+
+void HeaderEmitter::emit(SgGlobal * global) {
+    emitComments(global, PreprocessingInfo::before);
+    emitDeclarations(global->get_declarations(), global);
+    emitComments(global, PreprocessingInfo::inside);
+    emitComments(global, PreprocessingInfo::after);
+}
+
+void HeaderEmitter::emit(SgDeclarationStatement * decl) {
+    emitComments(decl, PreprocessingInfo::before);
+    emitDeclaration(decl, decl->get_scope());
+    emitComments(decl, PreprocessingInfo::after);
+}
+
+void HeaderEmitter::emitDeclarations(const SgDeclarationStatementPtrList & decls, SgScopeStatement * scope) {
+    BOOST_FOREACH(SgDeclarationStatement * decl, decls) {
+        emitComments(decl, PreprocessingInfo::before);
+        emitDeclaration(decl, scope);
+        emitComments(decl, PreprocessingInfo::after);
+    }
+}
+
+void HeaderEmitter::emitDeclaration(SgDeclarationStatement * decl, SgScopeStatement * scope) {
+    switch(decl->variantT()) {
+        case V_SgEnumDeclaration:
+            emitEnum(isSgEnumDeclaration(decl));
+            break;
+        case V_SgTypedefDeclaration:
+            emitTypedef(isSgTypedefDeclaration(decl), scope);
+            break;
+        case V_SgClassDeclaration:
+            emitClass(isSgClassDeclaration(decl), scope);
+            break;
+        case V_SgVariableDeclaration:
+            emitVariable(isSgVariableDeclaration(decl), scope);
+            break;
+        case V_SgFunctionDeclaration:
+        case V_SgMemberFunctionDeclaration:
+            emitFunction(isSgFunctionDeclaration(decl), scope);
+            break;
+        case V_SgNamespaceDeclarationStatement:
+            emitNamespace(isSgNamespaceDeclarationStatement(decl));
+            break;
+        default:
+            indent();
+            out += decl->unparseToString();
+            out += '\n';
+    }
+}
+
+// Access labels are written where a member's access differs from the
+// default for the kind of class it is in.
+void HeaderEmitter::emitAccess(SgDeclarationStatement * decl, SgScopeStatement * scope) {
+    SgClassDefinition * classDef = isSgClassDefinition(scope);
+    if(classDef == NULL) {
+        return;
+    }
+    bool isClass = classDef->get_declaration()->get_class_type() == SgClassDeclaration::e_class;
+    SgAccessModifier & access = decl->get_declarationModifier().get_accessModifier();
+    if(access.isPrivate() && !isClass) {
+        out += "private: ";
+    } else if(access.isProtected()) {
+        out += "protected: ";
+    } else if(access.isPublic() && isClass) {
+        out += "public: ";
+    }
+}
+
+void HeaderEmitter::emitEnum(SgEnumDeclaration * decl) {
+    indent();
+    out += "enum ";
+    out += decl->get_name().getString();
+    out += " {";
+    bool first = true;
+    BOOST_FOREACH(SgInitializedName * init, decl->get_enumerators()) {
+        if(!first) {
+            out += ',';
+        }
+        first = false;
+        out += init->get_name().getString();
+        SgAssignInitializer * assign = isSgAssignInitializer(init->get_initializer());
+        if(assign != NULL) {
+            out += '=';
+            out += assign->get_operand()->unparseToString();
+        }
+    }
+    out += "};\n";
+}
+
+void HeaderEmitter::emitTypedef(SgTypedefDeclaration * decl, SgScopeStatement * scope) {
+    indent();
+    emitAccess(decl, scope);
+    out += "typedef ";
+    out += declarator(decl->get_base_type(), decl->get_name().getString(), scope);
+    out += ";\n";
+}
+
+void HeaderEmitter::emitClass(SgClassDeclaration * decl, SgScopeStatement * scope) {
+    indent();
+    emitAccess(decl, scope);
+    switch(decl->get_class_type()) {
+        case SgClassDeclaration::e_struct:
+            out += "struct ";
+            break;
+        case SgClassDeclaration::e_union:
+            out += "union ";
+            break;
+        default:
+            out += "class ";
+    }
+    out += decl->get_name().getString();
+
+    SgClassDefinition * def = decl->get_definition();
+    if(decl->isForward() || def == NULL) {
+        out += ";\n";
+        return;
+    }
+
+    bool first = true;
+    BOOST_FOREACH(SgBaseClass * base, def->get_inheritances()) {
+        out += first ? " : " : ",";
+        first = false;
+        SgBaseClassModifier & modifier = base->get_baseClassModifier();
+        if(modifier.isVirtual()) {
+            out += "virtual ";
+        }
+        SgAccessModifier & access = modifier.get_accessModifier();
+        if(access.isPublic()) {
+            out += "public ";
+        } else if(access.isProtected()) {
+            out += "protected ";
+        } else if(access.isPrivate()) {
+            out += "private ";
+        }
+        out += typeName(base->get_base_class()->get_type(), scope);
+    }
+    out += " \n";
+    indent();
+    out += "{\n";
+    ++depth;
+    emitDeclarations(def->get_members(), def);
+    emitComments(def, PreprocessingInfo::inside);
+    --depth;
+    indent();
+    out += "}\n";
+    indent();
+    out += ";\n";
+}
+
+void HeaderEmitter::emitVariable(SgVariableDeclaration * decl, SgScopeStatement * scope) {
+    indent();
+    emitAccess(decl, scope);
+    bool first = true;
+    BOOST_FOREACH(SgInitializedName * var, decl->get_variables()) {
+        if(!first) {
+            out += ',';
+        }
+        first = false;
+        out += declarator(var->get_type(), var->get_name().getString(), scope);
+    }
+    if(decl->get_bitfield() != NULL) {
+        out += ':';
+        out += decl->get_bitfield()->unparseToString();
+    }
+    out += ";\n";
+}
+
+std::string HeaderEmitter::parameters(SgFunctionParameterList * params, SgScopeStatement * scope) {
+    std::string list;
+    if(params == NULL) {
+        return list;
+    }
+    bool first = true;
+    BOOST_FOREACH(SgInitializedName * param, params->get_args()) {
+        if(!first) {
+            list += ',';
+        }
+        first = false;
+        list += declarator(param->get_type(), param->get_name().getString(), scope);
+    }
+    return list;
+}
+
+void HeaderEmitter::emitFunction(SgFunctionDeclaration * decl, SgScopeStatement * scope) {
+    indent();
+    emitAccess(decl, scope);
+    SgFunctionModifier & modifier = decl->get_functionModifier();
+    if(modifier.isVirtual() || modifier.isPureVirtual()) {
+        out += "virtual ";
+    }
+
+    std::string inner = decl->get_name().getString() + "(" + parameters(decl->get_parameterList(), scope) + ")";
+    SgSpecialFunctionModifier & special = decl->get_specialFunctionModifier();
+    SgType * returnType = decl->get_orig_return_type();
+    if(special.isConstructor() || special.isDestructor() || special.isConversion()
+            || returnType == NULL || isSgTypeDefault(returnType)) {
+        out += inner;
+    } else {
+        out += declarator(returnType, inner, scope);
+    }
+    if(modifier.isPureVirtual()) {
+        out += " = 0";
+    }
+    out += ";\n";
+}
+
+void HeaderEmitter::emitNamespace(SgNamespaceDeclarationStatement * decl) {
+    indent();
+    out += "namespace ";
+    out += decl->get_name().getString();
+    out += '\n';
+    indent();
+    out += "{\n";
+    SgNamespaceDefinitionStatement * def = decl->get_definition();
+    if(def != NULL) {
+        ++depth;
+        emitDeclarations(def->get_declarations(), def);
+        emitComments(def, PreprocessingInfo::inside);
+        --depth;
+    }
+    indent();
+    out += "}\n";
+}
+
+std::string HeaderEmitter::typeName(SgType * type, SgScopeStatement * scope) {
+    const char * fundamental = fundamentalName(type->variantT());
+    if(fundamental[0] != '\0') {
+        return fundamental;
+    }
+    SgNamedType * named = isSgNamedType(type);
+    if(named != NULL) {
+        SgDeclarationStatement * decl = named->get_declaration();
+        if(decl != NULL && isVisibleFrom(decl->get_scope(), scope)) {
+            return named->get_name().getString();
+        }
+    }
+    // Qualified names and the rarer types are left to ROSE.
+    return type->unparseToString();
+}
+
+// Wraps the declarator built so far (at first just the declared name) in
+// the type, from the outside in, the way C declarators read.
+std::string HeaderEmitter::declarator(SgType * type, const std::string & inner, SgScopeStatement * scope) {
+    switch(type->variantT()) {
+        case V_SgPointerType:
+        case V_SgReferenceType: {
+            SgType * base = isSgPointerType(type) != NULL ? isSgPointerType(type)->get_base_type()
+                : isSgReferenceType(type)->get_base_type();
+            std::string d = (isSgPointerType(type) != NULL ? "*" : "&") + inner;
+            if(isSgArrayType(base) || isSgFunctionType(base)) {
+                d = "(" + d + ")";
+            }
+            return declarator(base, d, scope);
+        };
+
+        case V_SgModifierType: {
+            SgModifierType * modified = isSgModifierType(type);
+            SgConstVolatileModifier & cv = modified->get_typeModifier().get_constVolatileModifier();
+            std::string qualifier;
+            if(cv.isConst()) {
+                qualifier = "const";
+            }
+            if(cv.isVolatile()) {
+                qualifier += qualifier.empty() ? "volatile" : " volatile";
+            }
+            if(qualifier.empty()) {
+                // UPC and other modifiers
+                break;
+            }
+            SgType * base = modified->get_base_type();
+            if(isSgPointerType(base) || isSgReferenceType(base)) {
+                return declarator(base, inner.empty() ? qualifier : qualifier + " " + inner, scope);
+            }
+            return qualifier + " " + declarator(base, inner, scope);
+        };
+
+        case V_SgArrayType: {
+            SgArrayType * array = isSgArrayType(type);
+            std::string size = array->get_index() == NULL ? "" : array->get_index()->unparseToString();
+            return declarator(array->get_base_type(), inner + "[" + size + "]", scope);
+        };
+
+        case V_SgFunctionType: {
+            SgFunctionType * function = isSgFunctionType(type);
+            std::string args;
+            bool first = true;
+            BOOST_FOREACH(SgType * arg, function->get_arguments()) {
+                if(!first) {
+                    args += ',';
+                }
+                first = false;
+                args += declarator(arg, "", scope);
+            }
+            return declarator(function->get_return_type(), inner + "(" + args + ")", scope);
+        };
+
+        default: ;
+    }
+
+    std::string name = typeName(type, scope);
+    return inner.empty() ? name : name + " " + inner;
+}
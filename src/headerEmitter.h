@@ -0,0 +1,44 @@
+#ifndef __HEADEREMITTER_H__
+#define __HEADEREMITTER_H__
+
+#include "rose.h"
+#include <string>
+
+// Prints the declarations undwarf generates (enums, typedefs, classes,
+// structs and unions with their members and bitfields, function
+// prototypes and namespaces) straight into an output buffer, laid out the
+// way ROSE's unparser lays them out. This skips the general-purpose
+// unparser and the temporary strings it builds for every node. Anything
+// outside that set is still handed to ROSE, one declaration or type at a
+// time.
+class HeaderEmitter {
+    public:
+        explicit HeaderEmitter(std::string & o) : out(o), depth(0) {};
+
+        // Appends the whole file, like global->unparseToCompleteString().
+        void emit(SgGlobal * global);
+        // Appends a single declaration as it would appear in its scope.
+        void emit(SgDeclarationStatement * decl);
+
+    private:
+        std::string & out;
+        int depth;
+
+        void indent();
+        void emitComments(SgLocatedNode * n, PreprocessingInfo::RelativePositionType position);
+        void emitDeclarations(const SgDeclarationStatementPtrList & decls, SgScopeStatement * scope);
+        void emitDeclaration(SgDeclarationStatement * decl, SgScopeStatement * scope);
+        void emitEnum(SgEnumDeclaration * decl);
+        void emitTypedef(SgTypedefDeclaration * decl, SgScopeStatement * scope);
+        void emitClass(SgClassDeclaration * decl, SgScopeStatement * scope);
+        void emitVariable(SgVariableDeclaration * decl, SgScopeStatement * scope);
+        void emitFunction(SgFunctionDeclaration * decl, SgScopeStatement * scope);
+        void emitNamespace(SgNamespaceDeclarationStatement * decl);
+        void emitAccess(SgDeclarationStatement * decl, SgScopeStatement * scope);
+
+        std::string declarator(SgType * type, const std::string & inner, SgScopeStatement * scope);
+        std::string typeName(SgType * type, SgScopeStatement * scope);
+        std::string parameters(SgFunctionParameterList * params, SgScopeStatement * scope);
+};
+
+#endif
@@ -0,0 +1,324 @@
+#include "nameIndex.h"
+#include "dwarf.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <boost/lexical_cast.hpp>
+#include <boost/unordered_map.hpp>
+
+// Bumped whenever the image layout changes.
+static const uint64_t INDEX_MAGIC = 0x31786469647775ULL;    // "uwdidx1"
+static const size_t IDENTITY_SIZE = 4;
+static const uint32_t DECLARATION = 1;
+
+namespace {
+
+struct Header {
+    uint64_t magic;
+    uint64_t identity[IDENTITY_SIZE];
+    uint64_t count;
+    uint64_t namesSize;
+};
+
+}
+
+struct NameIndex::Entry {
+    uint64_t name;          // Offset into the names
+    uint64_t offset;
+    uint32_t unit;
+    uint32_t flags;
+};
+
+namespace {
+
+// Orders entries by name, then definitions before declarations, then by
+// where they are.
+class EntryOrder {
+    public:
+        explicit EntryOrder(const char * n) : names(n) {};
+
+        template<class E>
+        bool operator()(const E & a, const E & b) const {
+            int c = strcmp(names + a.name, names + b.name);
+            if(c != 0) {
+                return c < 0;
+            }
+            if(a.flags != b.flags) {
+                return a.flags < b.flags;
+            }
+            return a.unit != b.unit ? a.unit < b.unit : a.offset < b.offset;
+        };
+
+    private:
+        const char * names;
+};
+
+class IndexBuilder {
+    public:
+        std::vector<NameIndex::Location> locations;
+        std::vector<uint64_t> nameOffsets;
+        std::string names;
+
+        void add(const std::string & name, uint32_t unit, const DwarfDie & die) {
+            std::pair<boost::unordered_map<std::string, uint64_t>::iterator, bool> inserted =
+                interned.insert(std::make_pair(name, names.size()));
+            if(inserted.second) {
+                names.append(name.c_str(), name.size() + 1);
+            }
+            NameIndex::Location l;
+            l.unit = unit;
+            l.offset = die.offset;
+            l.declaration = die.declaration;
+            locations.push_back(l);
+            nameOffsets.push_back(inserted.first->second);
+        };
+
+        // Indexes the children of parent, which is the unit, a namespace
+        // or a type, whose qualified name is prefix.
+        void walk(const DwarfUnit & unit, uint32_t index, uint32_t parent, const std::string & prefix) {
+            for(uint32_t i = unit.dies[parent].firstChild; i != DwarfDie::NONE; i = unit.dies[i].nextSibling) {
+                const DwarfDie & die = unit.dies[i];
+                bool scope = false;
+                switch(die.tag) {
+                    case DW_TAG_namespace:
+                    case DW_TAG_class_type:
+                    case DW_TAG_structure_type:
+                    case DW_TAG_union_type:
+                        scope = true;
+                        break;
+                    case DW_TAG_enumeration_type:
+                    case DW_TAG_typedef:
+                    case DW_TAG_subprogram:
+                        break;
+                    default:
+                        continue;
+                }
+                std::string name = die.name.str();
+                if(name.empty()) {
+                    if(die.tag != DW_TAG_namespace) {
+                        continue;
+                    }
+                    name = "(anonymous namespace)";
+                }
+                if(!prefix.empty()) {
+                    name = prefix + "::" + name;
+                }
+                if(die.tag != DW_TAG_namespace) {
+                    add(name, index, die);
+                }
+                if(scope) {
+                    walk(unit, index, i, name);
+                }
+            }
+        };
+
+    private:
+        boost::unordered_map<std::string, uint64_t> interned;
+};
+
+}
+
+NameIndex::NameIndex() : image(NULL), imageSize(0), mapped(false), entries(NULL), count(0), names(NULL), namesSize(0) {
+}
+
+NameIndex::~NameIndex() {
+    unmap();
+}
+
+void NameIndex::unmap() {
+    if(mapped) {
+        munmap(const_cast<char *>(image), imageSize);
+    }
+    mapped = false;
+    image = NULL;
+    imageSize = 0;
+    entries = NULL;
+    count = 0;
+    names = NULL;
+    namesSize = 0;
+}
+
+bool NameIndex::attach(const char * data, uint64_t size, const std::vector<uint64_t> * identity) {
+    if(size < sizeof(Header)) {
+        return false;
+    }
+    Header header;
+    memcpy(&header, data, sizeof(header));
+    if(header.magic != INDEX_MAGIC || header.count > (size - sizeof(Header)) / sizeof(Entry) ||
+            sizeof(Header) + header.count * sizeof(Entry) + header.namesSize != size ||
+            (header.namesSize > 0 && data[size - 1] != '\0')) {
+        return false;
+    }
+    if(identity != NULL && (identity->size() != IDENTITY_SIZE ||
+                !std::equal(identity->begin(), identity->end(), header.identity))) {
+        return false;
+    }
+    image = data;
+    imageSize = size;
+    entries = reinterpret_cast<const Entry *>(data + sizeof(Header));
+    count = header.count;
+    names = data + sizeof(Header) + count * sizeof(Entry);
+    namesSize = header.namesSize;
+    return true;
+}
+
+bool NameIndex::build(ElfFile & elf, const DwarfReader & reader) {
+    unmap();
+    IndexBuilder builder;
+    for(uint32_t i = 0; i < reader.units().size(); ++i) {
+        const DwarfUnitHeader & header = reader.units()[i];
+        DwarfUnit unit;
+        if(!reader.readUnit(header, unit)) {
+            std::cerr << "WARNING: Compilation unit at offset " << header.offset << " in " << elf.path() << " was not fully read." << std::endl;
+        }
+        if(!unit.dies.empty()) {
+            builder.walk(unit, i, 0, std::string());
+        }
+        SectionData data = reader.unitData(header);
+        elf.release(data.data, data.size);
+    }
+
+    std::vector<Entry> sorted(builder.locations.size());
+    for(size_t i = 0; i < sorted.size(); ++i) {
+        sorted[i].name = builder.nameOffsets[i];
+        sorted[i].offset = builder.locations[i].offset;
+        sorted[i].unit = builder.locations[i].unit;
+        sorted[i].flags = builder.locations[i].declaration ? DECLARATION : 0;
+    }
+    std::sort(sorted.begin(), sorted.end(), EntryOrder(builder.names.c_str()));
+
+    Header header;
+    memset(&header, 0, sizeof(header));
+    header.magic = INDEX_MAGIC;
+    header.count = sorted.size();
+    header.namesSize = builder.names.size();
+    built.clear();
+    built.reserve(sizeof(header) + sorted.size() * sizeof(Entry) + builder.names.size());
+    built.append(reinterpret_cast<const char *>(&header), sizeof(header));
+    if(!sorted.empty()) {
+        built.append(reinterpret_cast<const char *>(&sorted[0]), sorted.size() * sizeof(Entry));
+    }
+    built += builder.names;
+    return attach(built.data(), built.size(), NULL);
+}
+
+std::vector<uint64_t> NameIndex::identify(const std::string & path) {
+    std::vector<uint64_t> identity;
+    struct stat st;
+    if(stat(path.c_str(), &st) == 0) {
+        identity.push_back(st.st_dev);
+        identity.push_back(st.st_ino);
+        identity.push_back(st.st_size);
+        identity.push_back(static_cast<uint64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec);
+    }
+    return identity;
+}
+
+bool NameIndex::load(const std::string & path, const std::vector<uint64_t> & identity) {
+    unmap();
+    built.clear();
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0) {
+        return false;
+    }
+    struct stat st;
+    void * data = MAP_FAILED;
+    if(fstat(fd, &st) == 0 && st.st_size > 0) {
+        data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if(data == MAP_FAILED) {
+        return false;
+    }
+    if(!attach(static_cast<const char *>(data), st.st_size, &identity)) {
+        munmap(data, st.st_size);
+        return false;
+    }
+    mapped = true;
+    return true;
+}
+
+bool NameIndex::save(const std::string & path, const std::vector<uint64_t> & identity) const {
+    if(image == NULL || identity.size() != IDENTITY_SIZE) {
+        return false;
+    }
+    Header header;
+    memcpy(&header, image, sizeof(header));
+    std::copy(identity.begin(), identity.end(), header.identity);
+
+    // Written under another name and renamed, so a reader never sees half
+    // an index.
+    std::string temp = path + ".tmp-" + boost::lexical_cast<std::string>(getpid());
+    int fd = open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if(fd < 0) {
+        std::cerr << "WARNING: Could not write name index " << temp << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    bool good = write(fd, &header, sizeof(header)) == sizeof(header);
+    const char * data = image + sizeof(header);
+    uint64_t size = imageSize - sizeof(header);
+    while(good && size > 0) {
+        ssize_t n = write(fd, data, size);
+        if(n < 0 && errno == EINTR) {
+            continue;
+        }
+        good = n > 0;
+        data += good ? n : 0;
+        size -= good ? n : 0;
+    }
+    good = close(fd) == 0 && good;
+    if(!good || rename(temp.c_str(), path.c_str()) != 0) {
+        std::cerr << "WARNING: Could not write name index " << path << ": " << strerror(errno) << std::endl;
+        unlink(temp.c_str());
+        return false;
+    }
+    return true;
+}
+
+namespace {
+
+// Compares an entry's name with the one looked for. An entry pointing
+// outside the names (a damaged file) sorts first and never matches.
+class NameLess {
+    public:
+        NameLess(const char * n, uint64_t s) : names(n), size(s) {};
+
+        template<class E>
+        bool operator()(const E & e, const char * name) const {
+            return e.name >= size || strcmp(names + e.name, name) < 0;
+        };
+
+        template<class E>
+        bool operator()(const char * name, const E & e) const {
+            return e.name < size && strcmp(name, names + e.name) < 0;
+        };
+
+    private:
+        const char * names;
+        uint64_t size;
+};
+
+}
+
+std::vector<NameIndex::Location> NameIndex::find(const std::string & name) const {
+    std::vector<Location> found;
+    NameLess less(names, namesSize);
+    const Entry * end = entries + count;
+    for(const Entry * e = std::lower_bound(entries, end, name.c_str(), less); e != end && !less(name.c_str(), *e); ++e) {
+        if(e->name >= namesSize) {
+            break;
+        }
+        Location l;
+        l.unit = e->unit;
+        l.offset = e->offset;
+        l.declaration = (e->flags & DECLARATION) != 0;
+        found.push_back(l);
+    }
+    return found;
+}
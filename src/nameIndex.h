@@ -0,0 +1,71 @@
+#ifndef __NAMEINDEX_H__
+#define __NAMEINDEX_H__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "elfFile.h"
+#include "dwarfReader.h"
+
+// Where each named type and function of a binary is declared, by
+// qualified name, so a few declarations can be found without converting
+// (or even reading) every compilation unit.
+//
+// The index is one flat image: a header, entries sorted by name, and the
+// names they point at. Lookups are a binary search over the entries, so
+// an index written to a file is used straight out of a read-only mapping.
+class NameIndex {
+    public:
+        struct Location {
+            uint32_t unit;          // Index into DwarfReader::units()
+            uint64_t offset;        // DIE offset within the unit
+            bool declaration;       // Only declared there, not defined
+        };
+
+        NameIndex();
+        ~NameIndex();
+
+        // Indexes every unit of the binary, reading each once. A type is
+        // indexed wherever it is declared; so is a function, including
+        // member functions inside their class.
+        bool build(ElfFile & elf, const DwarfReader & reader);
+
+        // Uses the index in the file at path if it was built for a binary
+        // of the given identity (see identify()). False if it is missing,
+        // stale or damaged.
+        bool load(const std::string & path, const std::vector<uint64_t> & identity);
+        // Writes the index to path, tagged with identity.
+        bool save(const std::string & path, const std::vector<uint64_t> & identity) const;
+
+        // What identifies the current contents of the file at path. Empty
+        // if it can't be read.
+        static std::vector<uint64_t> identify(const std::string & path);
+
+        size_t size() const { return count; };
+
+        // Every place name is declared, definitions first, then in unit
+        // order.
+        std::vector<Location> find(const std::string & name) const;
+
+    private:
+        struct Entry;
+
+        // The image being built or loaded; mapped when it came from a
+        // file.
+        std::string built;
+        const char * image;
+        uint64_t imageSize;
+        bool mapped;
+        const Entry * entries;
+        uint64_t count;
+        const char * names;
+        uint64_t namesSize;
+
+        void unmap();
+        bool attach(const char * data, uint64_t size, const std::vector<uint64_t> * identity);
+
+        NameIndex(NameIndex const &);
+        void operator=(NameIndex const &);
+};
+
+#endif
@@ -0,0 +1,119 @@
+#include "options.h"
+#include "rose.h"
+#include <iostream>
+#include <sstream>
+#include <boost/algorithm/string/predicate.hpp>
+
+// Collects every value given to a repeatable option.
+static void repeatedOption(std::vector<std::string> & args, const std::string & name, std::vector<std::string> & values) {
+    std::string value;
+    while(CommandlineProcessing::isOptionWithParameter(args, "-undwarf:", name, value, true)) {
+        values.push_back(value);
+    }
+}
+
+UndwarfOptions::UndwarfOptions() : native(false), stream(false), dedup(false), jobs(1), emitter(ROSE_UNPARSER), validate(VALIDATE_NONE), splitNamespaces(false), exported(false), watch(false), stats(false), traceTypes(0), verbose(0) {
+}
+
+void UndwarfOptions::parse(std::vector<std::string> & args) {
+    native = CommandlineProcessing::isOption(args, "-undwarf:", "(native)", true);
+    watch = CommandlineProcessing::isOption(args, "-undwarf:", "(watch)", true);
+    CommandlineProcessing::isOptionWithParameter(args, "-undwarf:", "(serve)", serveSocket, true);
+    // Every run's (or request's) IR has to go, or memory grows with each
+    // change.
+    stream = CommandlineProcessing::isOption(args, "-undwarf:", "(stream)", true) || watch || !serveSocket.empty();
+    dedup = CommandlineProcessing::isOption(args, "-undwarf:", "(dedup)", true);
+    CommandlineProcessing::isOptionWithParameter(args, "-undwarf:", "(j|jobs)", jobs, true);
+    if(jobs < 1) {
+        jobs = 1;
+    }
+    std::string emitterName;
+    if(CommandlineProcessing::isOptionWithParameter(args, "-undwarf:", "(emitter)", emitterName, true)) {
+        if(emitterName == "rose") {
+            emitter = ROSE_UNPARSER;
+        } else if(emitterName == "direct") {
+            emitter = DIRECT;
+        } else if(emitterName == "compare") {
+            emitter = COMPARE;
+        } else {
+            std::cerr << "WARNING: Unknown emitter " << emitterName << "; using rose." << std::endl;
+        }
+    }
+    std::string validateName;
+    if(CommandlineProcessing::isOptionWithParameter(args, "-undwarf:", "(validate)", validateName, true)) {
+        if(validateName == "none") {
+            validate = VALIDATE_NONE;
+        } else if(validateName == "structural") {
+            validate = VALIDATE_STRUCTURAL;
+        } else if(validateName == "full") {
+            validate = VALIDATE_FULL;
+        } else {
+            std::cerr << "WARNING: Unknown validation level " << validateName << "; using none." << std::endl;
+        }
+    }
+    CommandlineProcessing::isOptionWithParameter(args, "-undwarf:", "(output-dir)", outputDir, true);
+    splitNamespaces = CommandlineProcessing::isOption(args, "-undwarf:", "(split-namespaces)", true);
+    if(splitNamespaces && outputDir.empty()) {
+        std::cerr << "WARNING: -undwarf:split-namespaces needs -undwarf:output-dir; ignoring it." << std::endl;
+        splitNamespaces = false;
+    }
+    CommandlineProcessing::isOptionWithParameter(args, "-undwarf:", "(cache-dir)", cacheDir, true);
+    exported = CommandlineProcessing::isOption(args, "-undwarf:", "(exported)", true);
+    CommandlineProcessing::isOptionWithParameter(args, "-undwarf:", "(symbols)", symbolFile, true);
+    repeatedOption(args, "(include-file)", includeFiles);
+    repeatedOption(args, "(exclude-file)", excludeFiles);
+    repeatedOption(args, "(include)", includeNames);
+    repeatedOption(args, "(exclude)", excludeNames);
+    repeatedOption(args, "(query)", queries);
+    if(watch && !queries.empty()) {
+        std::cerr << "WARNING: -undwarf:watch can't be combined with -undwarf:query; ignoring it." << std::endl;
+        watch = false;
+    }
+    CommandlineProcessing::isOptionWithParameter(args, "-undwarf:", "(stats-json)", statsJson, true);
+    stats = CommandlineProcessing::isOption(args, "-undwarf:", "(stats)", true) || !statsJson.empty();
+    CommandlineProcessing::isOptionWithParameter(args, "-undwarf:", "(trace-types)", traceTypes, true);
+    CommandlineProcessing::isOptionWithParameter(args, "-undwarf:", "(trace)", traceFile, true);
+    if(traceTypes < 0) {
+        traceTypes = 0;
+    }
+    if(traceTypes > 0 && traceFile.empty()) {
+        std::cerr << "WARNING: -undwarf:trace-types needs -undwarf:trace; ignoring it." << std::endl;
+        traceTypes = 0;
+    }
+    // A unit's header leaves out the types an earlier one defined, so it
+    // only compiles as part of the whole output.
+    if(dedup && !outputDir.empty()) {
+        std::cerr << "WARNING: -undwarf:dedup can't be combined with -undwarf:output-dir; ignoring it." << std::endl;
+        dedup = false;
+    }
+    // Deduplication marks a type as written by the first unit defining
+    // it, before that unit is cut down to what the functions need, so a
+    // copy pruned there would be left out everywhere.
+    if(dedup && (exported || !symbolFile.empty())) {
+        std::cerr << "WARNING: -undwarf:dedup can't be combined with -undwarf:exported or -undwarf:symbols; ignoring it." << std::endl;
+        dedup = false;
+    }
+    // Only the native reader can load one unit at a time, and only it
+    // has the DIE records types and units are hashed from, the line
+    // tables declarations' files are named in, and the names queries are
+    // looked up by.
+    bool filtered = !includeNames.empty() || !excludeNames.empty() || !includeFiles.empty() || !excludeFiles.empty();
+    native = native || stream || dedup || !cacheDir.empty() || filtered || !queries.empty();
+
+    if(native) {
+        // The ROSE frontend won't see the arguments, so pick up the ones
+        // we'd otherwise get from it.
+        CommandlineProcessing::isOptionWithParameter(args, "-rose:", "(v|verbose)", verbose, true);
+        for(size_t i = 1; i < args.size(); ++i) {
+            if(!boost::starts_with(args[i], "-")) {
+                inputs.push_back(args[i]);
+            }
+        }
+    }
+}
+
+std::string UndwarfOptions::fingerprint() const {
+    std::ostringstream out;
+    out << "emitter=" << emitter << " split-namespaces=" << splitNamespaces << " dedup=" << dedup;
+    return out.str();
+}
@@ -0,0 +1,96 @@
+#ifndef __OPTIONS_H__
+#define __OPTIONS_H__
+
+#include <string>
+#include <vector>
+
+// Options understood by undwarf itself. They all start with -undwarf:
+// and are removed from the argument list before it reaches ROSE.
+class UndwarfOptions {
+    public:
+        enum Emitter {
+            ROSE_UNPARSER,  // global->unparseToCompleteString()
+            DIRECT,         // HeaderEmitter
+            COMPARE         // both; warns where they differ and prints ROSE's
+        };
+
+        // How much checking the ASTs get. Each level includes the ones
+        // before it.
+        enum Validation {
+            VALIDATE_NONE,
+            VALIDATE_STRUCTURAL,    // parent, scope and file info of every generated node
+            VALIDATE_FULL           // AstTests::runAllTests on the input and on every generated file
+        };
+
+        // Read the DWARF sections straight from the ELF file instead of
+        // running the ROSE binary frontend.
+        bool native;
+        // Free each compilation unit once its header is written. Implies native.
+        bool stream;
+        // Write each distinct type definition only once across all
+        // compilation units. Implies native.
+        bool dedup;
+        // Number of worker processes converting units side by side.
+        int jobs;
+        // How headers are turned into text.
+        Emitter emitter;
+        Validation validate;
+        // Write one header per unit into this directory instead of
+        // everything to standard output.
+        std::string outputDir;
+        // Also move each top-level namespace into a header of its own.
+        // Needs outputDir.
+        bool splitNamespaces;
+        // Reuse headers of unchanged units from earlier runs kept in this
+        // directory. Implies native.
+        std::string cacheDir;
+        // Only convert what the declarations of the input's exported
+        // functions need.
+        bool exported;
+        // Only convert what the declarations of the functions listed in
+        // this file need (together with the exported ones, if exported).
+        std::string symbolFile;
+        // Stay running and regenerate the headers whenever an input
+        // changes. Implies native and stream.
+        bool watch;
+        // Qualified name patterns (such as acme::net::*) and source path
+        // prefixes selecting what to convert. Declarations matching an
+        // exclude, or none of the includes when there are any, are left
+        // out with everything inside them. Imply native.
+        std::vector<std::string> includeNames;
+        std::vector<std::string> excludeNames;
+        std::vector<std::string> includeFiles;
+        std::vector<std::string> excludeFiles;
+        // Qualified names of types and functions to print the
+        // declarations of, with what they need, instead of whole units.
+        // Implies native.
+        std::vector<std::string> queries;
+        // Stay running and answer queries on this Unix domain socket.
+        // Implies native and stream.
+        std::string serveSocket;
+        // Time each phase of the run and count what was converted; print
+        // a summary to standard error, or write it to statsJson as JSON.
+        bool stats;
+        std::string statsJson;
+        // Write a Chrome trace of the run to traceFile: a span for each
+        // unit and each phase in it, and for every type conversion taking
+        // at least traceTypes microseconds (none if it is 0).
+        std::string traceFile;
+        int traceTypes;
+        int verbose;
+
+        // Binaries to read when not using the ROSE frontend.
+        std::vector<std::string> inputs;
+
+        UndwarfOptions();
+
+        void parse(std::vector<std::string> & args);
+
+        // Whether units are timed, for the stats or the trace.
+        bool measured() const { return stats || !traceFile.empty(); };
+
+        // The options that change what is generated, for cache keys.
+        std::string fingerprint() const;
+};
+
+#endif
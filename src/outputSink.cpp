@@ -0,0 +1,394 @@
+#include "outputSink.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <boost/functional/hash.hpp>
+#include <boost/lexical_cast.hpp>
+
+// Pending text for a file is written out once it reaches this size.
+static const size_t FLUSH_SIZE = 1 << 20;
+
+static void putString(std::string & out, const std::string & s) {
+    uint64_t size = s.size();
+    out.append(reinterpret_cast<const char *>(&size), sizeof(size));
+    out += s;
+}
+
+static bool getString(const std::string & in, size_t & at, std::string & s) {
+    uint64_t size;
+    if(in.size() - at < sizeof(size)) {
+        return false;
+    }
+    memcpy(&size, in.data() + at, sizeof(size));
+    at += sizeof(size);
+    if(in.size() - at < size) {
+        return false;
+    }
+    s.assign(in, at, size);
+    at += size;
+    return true;
+}
+
+std::string UnitOutput::encode() const {
+    std::string out;
+    size_t size = unitName.size() + header.size() + stats.size() + 4 * sizeof(uint64_t);
+    for(size_t i = 0; i < namespaces.size(); ++i) {
+        size += namespaces[i].first.size() + namespaces[i].second.size() + 2 * sizeof(uint64_t);
+    }
+    out.reserve(size);
+    putString(out, unitName);
+    putString(out, header);
+    uint64_t count = namespaces.size();
+    out.append(reinterpret_cast<const char *>(&count), sizeof(count));
+    for(size_t i = 0; i < namespaces.size(); ++i) {
+        putString(out, namespaces[i].first);
+        putString(out, namespaces[i].second);
+    }
+    if(!stats.empty()) {
+        putString(out, stats);
+    }
+    return out;
+}
+
+bool UnitOutput::decode(const std::string & in) {
+    size_t at = 0;
+    uint64_t count;
+    if(!getString(in, at, unitName) || !getString(in, at, header) || in.size() - at < sizeof(count)) {
+        return false;
+    }
+    memcpy(&count, in.data() + at, sizeof(count));
+    at += sizeof(count);
+    namespaces.resize(count);
+    for(size_t i = 0; i < count; ++i) {
+        if(!getString(in, at, namespaces[i].first) || !getString(in, at, namespaces[i].second)) {
+            return false;
+        }
+    }
+    stats.clear();
+    return at == in.size() || getString(in, at, stats);
+}
+
+void StreamSink::write(size_t unit, const std::string & encoded) {
+    UnitOutput output;
+    if(!output.decode(encoded)) {
+        std::cerr << "ERROR: Output of unit " << unit << " is corrupt." << std::endl;
+        return;
+    }
+    out << output.header << namespaceText(output.namespaces);
+    out.flush();
+}
+
+static std::vector<std::string> splitPath(const std::string & path) {
+    std::vector<std::string> names;
+    size_t start = 0;
+    for(size_t sep = path.find("::"); sep != std::string::npos; sep = path.find("::", start)) {
+        names.push_back(path.substr(start, sep - start));
+        start = sep + 2;
+    }
+    names.push_back(path.substr(start));
+    return names;
+}
+
+// Appends text with every non-empty line indented to depth.
+static void appendIndented(std::string & out, const std::string & text, size_t depth) {
+    size_t start = 0;
+    while(start < text.size()) {
+        size_t end = text.find('\n', start);
+        end = end == std::string::npos ? text.size() : end + 1;
+        if(end - start > 1) {
+            out.append(depth * 2, ' ');
+        }
+        out.append(text, start, end - start);
+        start = end;
+    }
+}
+
+std::string namespaceText(const std::vector<std::pair<std::string, std::string> > & pieces) {
+    std::string out;
+    // The namespaces open so far; those the next declaration shares stay open.
+    std::vector<std::string> open;
+    for(size_t i = 0; i < pieces.size(); ++i) {
+        std::vector<std::string> names = splitPath(pieces[i].first);
+        size_t shared = 0;
+        while(shared < open.size() && shared < names.size() && open[shared] == names[shared]) {
+            ++shared;
+        }
+        while(open.size() > shared) {
+            open.pop_back();
+            out.append(open.size() * 2, ' ');
+            out += "}\n";
+        }
+        while(open.size() < names.size()) {
+            out.append(open.size() * 2, ' ');
+            out += "namespace " + names[open.size()] + "\n";
+            out.append(open.size() * 2, ' ');
+            out += "{\n";
+            open.push_back(names[open.size()]);
+        }
+        appendIndented(out, pieces[i].second, open.size());
+    }
+    while(!open.empty()) {
+        open.pop_back();
+        out.append(open.size() * 2, ' ');
+        out += "}\n";
+    }
+    return out;
+}
+
+static std::string sanitize(const std::string & name) {
+    std::string file;
+    for(size_t i = 0; i < name.size(); ++i) {
+        char c = name[i];
+        bool plain = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')
+            || c == '.' || c == '-' || c == '_';
+        file += plain ? c : '_';
+    }
+    // No hidden files, and nothing that reads as a path.
+    size_t start = file.find_first_not_of("._");
+    return start == std::string::npos ? std::string() : file.substr(start);
+}
+
+bool makeDirectories(const std::string & path) {
+    for(size_t slash = path.find('/', 1); ; slash = path.find('/', slash + 1)) {
+        std::string prefix = path.substr(0, slash);
+        if(!prefix.empty() && mkdir(prefix.c_str(), 0777) != 0 && errno != EEXIST) {
+            return false;
+        }
+        if(slash == std::string::npos) {
+            return true;
+        }
+    }
+}
+
+DirectorySink::DirectorySink(const std::string & d, unsigned writerCount) : directory(d), ok(true), finished(false) {
+    if(!makeDirectories(directory)) {
+        std::cerr << "ERROR: Could not create output directory " << directory << ": " << strerror(errno) << std::endl;
+        ok = false;
+    }
+    if(writerCount == 0) {
+        writerCount = 1;
+    }
+    for(unsigned i = 0; i < writerCount; ++i) {
+        Writer * w = new Writer();
+        writers.push_back(w);
+        threads.push_back(new boost::thread(&Writer::run, w));
+    }
+}
+
+DirectorySink::~DirectorySink() {
+    finish();
+    for(size_t i = 0; i < writers.size(); ++i) {
+        delete threads[i];
+        delete writers[i];
+    }
+}
+
+std::string DirectorySink::unitFile(const UnitOutput & output, size_t unit) {
+    std::string base = sanitize(output.unitName);
+    if(base.empty()) {
+        base = "unit-" + boost::lexical_cast<std::string>(unit);
+    }
+    // A suffix can make the name of another unit (x, x, x-2), so it is
+    // counted up until the file is free.
+    size_t & seen = unitNames[base];
+    std::string file;
+    do {
+        ++seen;
+        file = seen == 1 ? base + ".h" : base + "-" + boost::lexical_cast<std::string>(seen) + ".h";
+    } while(!unitFiles.insert(file).second);
+    return file;
+}
+
+// UNDWARF_ and the file name in capitals, with a number added if another
+// file already has that guard.
+std::string DirectorySink::guard(const std::string & file) {
+    std::string base = "UNDWARF_";
+    for(size_t i = 0; i < file.size(); ++i) {
+        char c = file[i];
+        if(c >= 'a' && c <= 'z') {
+            base += c - 'a' + 'A';
+        } else if((c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')) {
+            base += c;
+        } else {
+            base += '_';
+        }
+    }
+    std::string macro = base;
+    for(size_t n = 2; !guards.insert(macro).second; ++n) {
+        macro = base + "_" + boost::lexical_cast<std::string>(n);
+    }
+    return macro;
+}
+
+void DirectorySink::send(const std::string & file, const std::string & text, bool last) {
+    Request * request = new Request();
+    request->path = directory + "/" + file;
+    request->text = text;
+    request->last = last;
+    size_t writer = boost::hash<std::string>()(file) % writers.size();
+    writers[writer]->queue.push(request);
+}
+
+void DirectorySink::write(size_t unit, const std::string & encoded) {
+    UnitOutput output;
+    if(!output.decode(encoded)) {
+        std::cerr << "ERROR: Output of unit " << unit << " is corrupt." << std::endl;
+        ok = false;
+        return;
+    }
+    std::string file = unitFile(output, unit);
+
+    // The namespace files this unit has declarations for, in the order it
+    // first has one, those no unit had before, and the unit's
+    // declarations they don't have yet.
+    std::vector<std::string> included;
+    std::set<std::string> created;
+    std::map<std::string, std::vector<std::pair<std::string, std::string> > > added;
+    for(size_t i = 0; i < output.namespaces.size(); ++i) {
+        const std::pair<std::string, std::string> & piece = output.namespaces[i];
+        std::string name = sanitize(piece.first.substr(0, piece.first.find("::")));
+        std::string namespaceFile = "namespace-" + (name.empty() ? std::string("anonymous") : name) + ".h";
+        if(std::find(included.begin(), included.end(), namespaceFile) == included.end()) {
+            included.push_back(namespaceFile);
+            if(namespaceFiles.find(namespaceFile) == namespaceFiles.end()) {
+                created.insert(namespaceFile);
+            }
+        }
+        ContentHasher hasher;
+        hasher.update(static_cast<uint64_t>(piece.first.size()));
+        hasher.update(piece.first);
+        hasher.update(piece.second);
+        if(namespaceFiles[namespaceFile].insert(hasher.digest()).second) {
+            added[namespaceFile].push_back(piece);
+        }
+    }
+
+    std::string macro = guard(file);
+    std::string text = "#ifndef " + macro + "\n#define " + macro + "\n\n";
+    for(size_t i = 0; i < included.size(); ++i) {
+        text += "#include \"" + included[i] + "\"\n";
+    }
+    if(!included.empty()) {
+        text += "\n";
+    }
+    text += output.header + "#endif\n";
+    send(file, text, true);
+
+    for(size_t i = 0; i < included.size(); ++i) {
+        std::map<std::string, std::vector<std::pair<std::string, std::string> > >::iterator it = added.find(included[i]);
+        if(it == added.end()) {
+            continue;
+        }
+        std::string declarations = namespaceText(it->second);
+        if(created.count(included[i]) > 0) {
+            macro = guard(included[i]);
+            declarations = "#ifndef " + macro + "\n#define " + macro + "\n\n" + declarations;
+        }
+        send(included[i], declarations, false);
+    }
+}
+
+bool DirectorySink::finish() {
+    if(!finished) {
+        finished = true;
+        std::map<std::string, std::set<ContentDigest> >::const_iterator it;
+        for(it = namespaceFiles.begin(); it != namespaceFiles.end(); ++it) {
+            send(it->first, "\n#endif\n", true);
+        }
+        for(size_t i = 0; i < writers.size(); ++i) {
+            writers[i]->queue.close();
+        }
+        for(size_t i = 0; i < threads.size(); ++i) {
+            threads[i]->join();
+        }
+        for(size_t i = 0; i < writers.size(); ++i) {
+            ok = ok && !writers[i]->failed;
+        }
+    }
+    return ok;
+}
+
+void DirectorySink::Writer::run() {
+    Request * request;
+    while(queue.pop(request)) {
+        std::map<std::string, OpenFile>::iterator it = files.find(request->path);
+        if(it == files.end()) {
+            OpenFile file;
+            file.fd = -1;
+            it = files.insert(std::make_pair(request->path, file)).first;
+            // Created now, so only ever opened for appending from here on.
+            int fd = open(request->path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+            if(fd >= 0) {
+                close(fd);
+            }
+        }
+        OpenFile & file = it->second;
+        file.pending += request->text;
+        if(request->last || file.pending.size() >= FLUSH_SIZE) {
+            flush(it->first, file);
+        }
+        if(request->last) {
+            if(file.fd >= 0) {
+                close(file.fd);
+            }
+            files.erase(it);
+        }
+        delete request;
+    }
+
+    for(std::map<std::string, OpenFile>::iterator it = files.begin(); it != files.end(); ++it) {
+        flush(it->first, it->second);
+        if(it->second.fd >= 0) {
+            close(it->second.fd);
+        }
+    }
+    files.clear();
+}
+
+bool DirectorySink::Writer::flush(const std::string & path, OpenFile & file) {
+    if(file.pending.empty()) {
+        return true;
+    }
+    if(file.fd < 0) {
+        file.fd = open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0666);
+        if(file.fd < 0 && (errno == EMFILE || errno == ENFILE)) {
+            // Too many namespace files open; they are reopened as needed.
+            for(std::map<std::string, OpenFile>::iterator it = files.begin(); it != files.end(); ++it) {
+                if(it->second.fd >= 0) {
+                    close(it->second.fd);
+                    it->second.fd = -1;
+                }
+            }
+            file.fd = open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0666);
+        }
+        if(file.fd < 0) {
+            std::cerr << "ERROR: Could not open " << path << ": " << strerror(errno) << std::endl;
+            failed = true;
+            file.pending.clear();
+            return false;
+        }
+    }
+
+    const char * data = file.pending.data();
+    size_t size = file.pending.size();
+    while(size > 0) {
+        ssize_t n = ::write(file.fd, data, size);
+        if(n < 0 && errno == EINTR) {
+            continue;
+        }
+        if(n <= 0) {
+            std::cerr << "ERROR: Could not write " << path << ": " << strerror(errno) << std::endl;
+            failed = true;
+            break;
+        }
+        data += n;
+        size -= n;
+    }
+    file.pending.clear();
+    return !failed;
+}
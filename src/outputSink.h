@@ -0,0 +1,127 @@
+#ifndef __OUTPUTSINK_H__
+#define __OUTPUTSINK_H__
+
+#include <map>
+#include <ostream>
+#include <set>
+#include <string>
+#include <vector>
+#include <boost/thread/thread.hpp>
+#include "boundedQueue.h"
+#include "contentHash.h"
+
+// Creates path and any missing parent directories, like mkdir -p.
+bool makeDirectories(const std::string & path);
+
+// Puts declarations split out by namespace, as in UnitOutput::namespaces,
+// back inside namespace blocks.
+std::string namespaceText(const std::vector<std::pair<std::string, std::string> > & pieces);
+
+// What converting one compilation unit produces: the unit's own header
+// and, when output is split by namespace, the declarations that go to
+// each top-level namespace's header. Units are passed around in encoded
+// form, since results come back from workers as plain bytes.
+struct UnitOutput {
+    std::string unitName;
+    std::string header;
+    // One declaration per entry, in order, with the path of namespaces it
+    // is in, outermost first and joined with "::"
+    std::vector<std::pair<std::string, std::string> > namespaces;
+    // Encoded UnitStats, with -undwarf:stats; empty otherwise, and left
+    // out of the encoding then
+    std::string stats;
+
+    std::string encode() const;
+    bool decode(const std::string & encoded);
+};
+
+// Where finished units go. write() is called once per unit, in unit order.
+class UnitSink {
+    public:
+        virtual ~UnitSink() {};
+        virtual void write(size_t unit, const std::string & encoded) = 0;
+        // Called after the last unit; false if anything failed to be written.
+        virtual bool finish() { return true; };
+};
+
+// Everything to one stream, one header after another.
+class StreamSink : public UnitSink {
+    public:
+        explicit StreamSink(std::ostream & o) : out(o) {};
+        virtual void write(size_t unit, const std::string & encoded);
+
+    private:
+        std::ostream & out;
+};
+
+// One file per unit in a directory, plus one per top-level namespace if
+// the units were split by namespace. Unit files are named after the
+// unit's DW_AT_name with anything but letters, digits, '.', '-' and '_'
+// replaced; when two units have the same name the later one gets a
+// numbered suffix, so names only depend on the input. Namespace files are
+// called namespace-NAME.h and collect that namespace's declarations from
+// every unit, in unit order; a declaration an earlier unit already gave
+// the file is left out. Every file has an include guard, and each unit
+// file includes the namespace files its declarations went to.
+//
+// Files are written by a few writer threads; each file always goes to
+// the same thread, so the pieces of a namespace file stay in order, and
+// is written in large blocks.
+class DirectorySink : public UnitSink {
+    public:
+        DirectorySink(const std::string & directory, unsigned writers);
+        virtual ~DirectorySink();
+
+        // False if the directory couldn't be created.
+        bool valid() const { return ok; };
+
+        virtual void write(size_t unit, const std::string & encoded);
+        virtual bool finish();
+
+    private:
+        struct Request {
+            std::string path;
+            std::string text;
+            // Unit files are complete in one request; namespace files
+            // stay open for more.
+            bool last;
+        };
+
+        class Writer {
+            public:
+                Writer() : queue(16), failed(false) {};
+                void run();
+
+                BoundedQueue<Request *> queue;
+                bool failed;
+
+            private:
+                struct OpenFile {
+                    int fd;
+                    std::string pending;
+                };
+                std::map<std::string, OpenFile> files;
+
+                bool flush(const std::string & path, OpenFile & file);
+        };
+
+        std::string directory;
+        bool ok;
+        bool finished;
+        std::vector<Writer *> writers;
+        std::vector<boost::thread *> threads;
+        // How many files were named after each unit name, and every
+        // file name given out, so no two units share a file.
+        std::map<std::string, size_t> unitNames;
+        std::set<std::string> unitFiles;
+        // Include guards given out, and the digests of the declarations
+        // each namespace file has, by file
+        std::set<std::string> guards;
+        std::map<std::string, std::set<ContentDigest> > namespaceFiles;
+
+        std::string unitFile(const UnitOutput & output, size_t unit);
+        std::string guard(const std::string & file);
+        void send(const std::string & file, const std::string & text, bool last);
+};
+
+#endif
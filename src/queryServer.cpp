@@ -0,0 +1,135 @@
+#include "queryServer.h"
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <boost/lexical_cast.hpp>
+#include <boost/thread/thread.hpp>
+
+namespace {
+
+// Longest request line accepted; anything longer is a confused client.
+const size_t MAX_REQUEST = 1 << 16;
+
+bool sendAll(int fd, const char * data, size_t size) {
+    while(size > 0) {
+        ssize_t n = send(fd, data, size, MSG_NOSIGNAL);
+        if(n < 0 && errno == EINTR) {
+            continue;
+        }
+        if(n <= 0) {
+            return false;
+        }
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+bool respond(int fd, bool ok, const std::string & answer) {
+    std::string response;
+    if(ok) {
+        response = "OK " + boost::lexical_cast<std::string>(answer.size()) + "\n" + answer;
+    } else {
+        // The message has to stay on one line.
+        std::string message = answer;
+        for(size_t i = 0; i < message.size(); ++i) {
+            if(message[i] == '\n') {
+                message[i] = ' ';
+            }
+        }
+        response = "ERROR " + message + "\n";
+    }
+    return sendAll(fd, response.data(), response.size());
+}
+
+void serveConnection(int fd, QueryHandler * handler, bool verbose) {
+    std::string buffer;
+    char chunk[4096];
+    bool open = true;
+    while(open) {
+        size_t newline = buffer.find('\n');
+        if(newline == std::string::npos) {
+            ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+            if(n < 0 && errno == EINTR) {
+                continue;
+            }
+            if(n <= 0 || buffer.size() + n > MAX_REQUEST) {
+                break;
+            }
+            buffer.append(chunk, n);
+            continue;
+        }
+
+        std::string line = buffer.substr(0, newline);
+        buffer.erase(0, newline + 1);
+        if(!line.empty() && line[line.size() - 1] == '\r') {
+            line.erase(line.size() - 1);
+        }
+        std::istringstream words(line);
+        std::string command;
+        std::vector<std::string> arguments;
+        words >> command;
+        for(std::string word; words >> word; ) {
+            arguments.push_back(word);
+        }
+        if(command.empty()) {
+            continue;
+        }
+        if(verbose) {
+            std::cerr << "Request: " << line << std::endl;
+        }
+        std::string answer;
+        bool ok = handler->answer(command, arguments, answer);
+        open = respond(fd, ok, answer);
+    }
+    close(fd);
+}
+
+}
+
+bool QueryServer::serve(const std::string & path, QueryHandler & handler, bool verbose) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if(path.size() >= sizeof(address.sun_path)) {
+        std::cerr << "ERROR: Socket path " << path << " is too long." << std::endl;
+        return false;
+    }
+    strcpy(address.sun_path, path.c_str());
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(listener < 0) {
+        std::cerr << "ERROR: Could not create socket: " << strerror(errno) << std::endl;
+        return false;
+    }
+    // A socket left behind by an earlier server that went away.
+    struct stat st;
+    if(stat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+        unlink(path.c_str());
+    }
+    if(bind(listener, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) != 0 || listen(listener, SOMAXCONN) != 0) {
+        std::cerr << "ERROR: Could not listen on " << path << ": " << strerror(errno) << std::endl;
+        close(listener);
+        return false;
+    }
+    std::cerr << "Serving queries on " << path << std::endl;
+
+    while(true) {
+        int fd = accept(listener, NULL, NULL);
+        if(fd < 0) {
+            if(errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            std::cerr << "ERROR: Could not accept connection: " << strerror(errno) << std::endl;
+            close(listener);
+            return false;
+        }
+        boost::thread connection(serveConnection, fd, &handler, verbose);
+        connection.detach();
+    }
+}
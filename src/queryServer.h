@@ -0,0 +1,35 @@
+#ifndef __QUERYSERVER_H__
+#define __QUERYSERVER_H__
+
+#include <string>
+#include <vector>
+
+// Answers the requests of one server. Called from many connection
+// threads at once; implementations do their own locking.
+class QueryHandler {
+    public:
+        virtual ~QueryHandler() {};
+
+        // Answers command with arguments, or returns false with a message
+        // in answer for a request that can't be answered.
+        virtual bool answer(const std::string & command, const std::vector<std::string> & arguments,
+                std::string & answer) = 0;
+};
+
+// Serves a QueryHandler on a Unix domain socket, one thread per
+// connection.
+//
+// The protocol is line-oriented. A request is a line holding a command
+// and its arguments separated by spaces. The response is either
+//     OK <length>\n<length bytes of answer>
+// or
+//     ERROR <message>\n
+// and a connection can carry any number of requests.
+namespace QueryServer {
+    // Listens on path, replacing a stale socket there, and serves until
+    // the process ends. Returns false (and prints a message) if the
+    // socket can't be set up.
+    bool serve(const std::string & path, QueryHandler & handler, bool verbose);
+}
+
+#endif
@@ -0,0 +1,156 @@
+#include "reachability.h"
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include <boost/algorithm/string/trim.hpp>
+#include <boost/foreach.hpp>
+
+bool Reachability::readSymbolList(const std::string & path, SymbolSet & symbols) {
+    std::ifstream in(path.c_str());
+    if(!in) {
+        std::cerr << "ERROR: Unable to read symbol list " << path << std::endl;
+        return false;
+    }
+    std::string line;
+    while(std::getline(in, line)) {
+        boost::algorithm::trim(line);
+        if(!line.empty() && line[0] != '#') {
+            symbols.insert(line);
+        }
+    }
+    return true;
+}
+
+namespace {
+
+class Closure {
+    public:
+        explicit Closure(DieTable & t) : table(t), kept(0) {};
+
+        size_t count() const { return kept; };
+
+        void keep(DieAnnotation * attr) {
+            if(attr != NULL && attr->pruned) {
+                attr->pruned = false;
+                ++kept;
+                work.push_back(attr);
+            }
+        };
+
+        void keep(SgAsmDwarfConstruct * c) {
+            if(c != NULL) {
+                keep(table.find(c));
+            }
+        };
+
+        void drain() {
+            while(!work.empty()) {
+                DieAnnotation * attr = work.back();
+                work.pop_back();
+                follow(attr);
+            }
+        };
+
+    private:
+        DieTable & table;
+        size_t kept;
+        std::vector<DieAnnotation *> work;
+
+        static SgAsmDwarfConstruct * enclosing(SgAsmDwarfConstruct * c) {
+            SgNode * p = c->get_parent();
+            while(p != NULL && !isSgAsmDwarfConstruct(p)) {
+                p = p->get_parent();
+            }
+            return isSgAsmDwarfConstruct(p);
+        };
+
+        void follow(DieAnnotation * attr) {
+            SgAsmDwarfConstruct * c = attr->construct;
+            keep(enclosing(c));
+            keep(attr->type);
+            keep(attr->spec);
+
+            SgAsmDwarfConstructList * children = c->get_children();
+            if(children == NULL) {
+                return;
+            }
+            switch(c->variantT()) {
+                // Scopes only need what is kept for its own sake.
+                case V_SgAsmDwarfCompilationUnit:
+                case V_SgAsmDwarfNamespace:
+                    break;
+
+                // A function's locals and nested types aren't part of its
+                // declaration.
+                case V_SgAsmDwarfSubprogram:
+                    BOOST_FOREACH(SgAsmDwarfConstruct * child, children->get_list()) {
+                        if(isSgAsmDwarfFormalParameter(child)) {
+                            keep(child);
+                        }
+                    }
+                    break;
+
+                // A type is only complete with all of its members.
+                default:
+                    BOOST_FOREACH(SgAsmDwarfConstruct * child, children->get_list()) {
+                        keep(child);
+                    }
+            }
+        };
+};
+
+}
+
+// Keeps what the roots already given to closure need. Out-of-line
+// definitions of kept member functions point at their declaration;
+// keeping them can reach more types, and so on.
+static size_t keepNeeded(DieTable & table, Closure & closure) {
+    closure.drain();
+    bool added = true;
+    while(added) {
+        added = false;
+        for(size_t id = 0; id < table.size(); ++id) {
+            DieAnnotation & attr = table[id];
+            if(attr.pruned && attr.spec != NULL && isSgAsmDwarfSubprogram(attr.construct)) {
+                DieAnnotation * spec = table.find(attr.spec);
+                if(spec != NULL && !spec->pruned) {
+                    closure.keep(&attr);
+                    added = true;
+                }
+            }
+        }
+        closure.drain();
+    }
+    return closure.count();
+}
+
+static void pruneAll(DieTable & table) {
+    for(size_t id = 0; id < table.size(); ++id) {
+        table[id].pruned = true;
+    }
+}
+
+size_t Reachability::prune(DieTable & table, const SymbolSet & symbols) {
+    Closure closure(table);
+    pruneAll(table);
+    for(size_t id = 0; id < table.size(); ++id) {
+        SgAsmDwarfSubprogram * sub = isSgAsmDwarfSubprogram(table[id].construct);
+        if(sub == NULL) {
+            continue;
+        }
+        std::string linkageName = sub->get_linkage_name();
+        if(symbols.count(linkageName) > 0 || (linkageName.empty() && symbols.count(sub->get_name()) > 0)) {
+            closure.keep(&table[id]);
+        }
+    }
+    return keepNeeded(table, closure);
+}
+
+size_t Reachability::prune(DieTable & table, const std::vector<uint64_t> & offsets) {
+    Closure closure(table);
+    pruneAll(table);
+    BOOST_FOREACH(uint64_t offset, offsets) {
+        closure.keep(table.find(offset));
+    }
+    return keepNeeded(table, closure);
+}
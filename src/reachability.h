@@ -0,0 +1,31 @@
+#ifndef __REACHABILITY_H__
+#define __REACHABILITY_H__
+
+#include "attributes.h"
+#include <string>
+#include <vector>
+#include <boost/unordered_set.hpp>
+
+typedef boost::unordered_set<std::string> SymbolSet;
+
+// Cuts a compilation unit down to what the declarations of a set of
+// functions need, such as a library's exported interface.
+namespace Reachability {
+    // Reads symbol names, one per line, adding them to symbols. Returns
+    // false (and prints a message) if the file can't be read.
+    bool readSymbolList(const std::string & path, SymbolSet & symbols);
+
+    // Marks every construct in the table as pruned unless a function
+    // named in symbols (by linkage name, or by name for C) needs it. Kept
+    // are the functions themselves, everything their return and parameter
+    // types lead to through the annotated type and specification links,
+    // all members of every class that is kept, and the enclosing scopes
+    // of all of those. Returns the number of constructs kept.
+    size_t prune(DieTable & table, const SymbolSet & symbols);
+
+    // The same, keeping the constructs at the given offsets, which may be
+    // types as well as functions, and what they need.
+    size_t prune(DieTable & table, const std::vector<uint64_t> & offsets);
+}
+
+#endif
@@ -0,0 +1,373 @@
+#include "runStats.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <sys/syscall.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <boost/foreach.hpp>
+
+// Units listed by name in the table; the JSON file has all of them.
+static const size_t SLOWEST_SHOWN = 10;
+
+// The kernel's id of the calling thread, as trace viewers expect.
+static int threadId() {
+    return syscall(SYS_gettid);
+}
+
+// A span of the calling thread.
+static TraceSpan makeSpan(const std::string & name, const std::string & category, uint64_t start, uint64_t end) {
+    TraceSpan span;
+    span.name = name;
+    span.category = category;
+    span.start = start;
+    span.duration = end - start;
+    span.pid = getpid();
+    span.tid = threadId();
+    return span;
+}
+
+UnitStats::UnitStats() : declarations(0), typesConverted(0), tracing(false), typeSpanMinimum(0), typeDepth(0) {
+    std::fill(phaseTime, phaseTime + PHASE_COUNT, 0);
+}
+
+const char * UnitStats::phaseName(Phase p) {
+    static const char * names[PHASE_COUNT] = { "read", "index", "traversal", "order", "validate", "output" };
+    return names[p];
+}
+
+void UnitStats::startTrace(uint64_t typeMinimum) {
+    tracing = true;
+    typeSpanMinimum = typeMinimum;
+}
+
+void UnitStats::addSpan(const std::string & name, const std::string & category, uint64_t start, uint64_t end) {
+    spans.push_back(makeSpan(name, category, start, end));
+}
+
+// A span per line; the name goes last, as it may have spaces.
+static void encodeSpans(std::ostream & out, const std::vector<TraceSpan> & spans) {
+    out << spans.size() << "\n";
+    BOOST_FOREACH(const TraceSpan & span, spans) {
+        out << span.start << " " << span.duration << " " << span.pid << " " << span.tid << " " << span.category
+            << " " << span.name << "\n";
+    }
+}
+
+static bool decodeSpans(std::istream & in, std::vector<TraceSpan> & spans) {
+    size_t count = 0;
+    in >> count;
+    spans.clear();
+    for(size_t i = 0; i < count && in; ++i) {
+        TraceSpan span;
+        in >> span.start >> span.duration >> span.pid >> span.tid >> span.category;
+        in.get();
+        std::getline(in, span.name);
+        spans.push_back(span);
+    }
+    return !in.fail();
+}
+
+std::string UnitStats::encode() const {
+    std::ostringstream out;
+    for(int p = 0; p < PHASE_COUNT; ++p) {
+        out << phaseTime[p] << " ";
+    }
+    out << declarations << " " << typesConverted << " " << dies.size() << "\n";
+    for(std::map<std::string, uint64_t>::const_iterator it = dies.begin(); it != dies.end(); ++it) {
+        out << it->first << " " << it->second << "\n";
+    }
+    encodeSpans(out, spans);
+    return out.str();
+}
+
+bool UnitStats::decode(const std::string & encoded) {
+    std::istringstream in(encoded);
+    for(int p = 0; p < PHASE_COUNT; ++p) {
+        in >> phaseTime[p];
+    }
+    size_t tags = 0;
+    in >> declarations >> typesConverted >> tags;
+    dies.clear();
+    for(size_t i = 0; i < tags && in; ++i) {
+        std::string tag;
+        uint64_t count = 0;
+        in >> tag >> count;
+        dies[tag] = count;
+    }
+    return !in.fail() && decodeSpans(in, spans);
+}
+
+PhaseTimer::PhaseTimer(UnitStats * s, UnitStats::Phase p) : stats(s), phase(p), start(0), running(s != NULL) {
+    if(running) {
+        start = RunStats::microseconds();
+    }
+}
+
+void PhaseTimer::next(UnitStats::Phase p) {
+    if(stats == NULL) {
+        return;
+    }
+    uint64_t now = RunStats::microseconds();
+    if(running) {
+        add(now);
+    }
+    phase = p;
+    start = now;
+    running = true;
+}
+
+void PhaseTimer::stop() {
+    if(running) {
+        add(RunStats::microseconds());
+        running = false;
+    }
+}
+
+void PhaseTimer::add(uint64_t now) {
+    stats->phaseTime[phase] += now - start;
+    if(stats->tracing) {
+        stats->addSpan(UnitStats::phaseName(phase), "phase", start, now);
+    }
+}
+
+RunStats::RunStats() : started(microseconds()), frontendTime(0), testsTime(0), writeTime(0), bytesWritten(0), cachedUnits(0) {
+}
+
+uint64_t RunStats::microseconds() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000000ULL + tv.tv_usec;
+}
+
+void RunStats::addFrontend(uint64_t start, uint64_t end) {
+    frontendTime += end - start;
+    addSpan("frontend", "run", start, end);
+}
+
+void RunStats::addTests(uint64_t start, uint64_t end) {
+    testsTime += end - start;
+    addSpan("AstTests", "run", start, end);
+}
+
+void RunStats::addWrite(const std::string & unitName, uint64_t start, uint64_t end) {
+    writeTime += end - start;
+    addSpan(unitName.empty() ? std::string("write") : "write " + unitName, "write", start, end);
+}
+
+void RunStats::addSpan(const std::string & name, const std::string & category, uint64_t start, uint64_t end) {
+    spans.push_back(makeSpan(name, category, start, end));
+}
+
+void RunStats::addUnit(const UnitStats * stats, uint64_t bytes) {
+    bytesWritten += bytes;
+    if(stats == NULL) {
+        ++cachedUnits;
+    } else {
+        units.push_back(*stats);
+    }
+}
+
+static uint64_t unitTotal(const UnitStats & u) {
+    uint64_t total = 0;
+    for(int p = 0; p < UnitStats::PHASE_COUNT; ++p) {
+        total += u.phaseTime[p];
+    }
+    return total;
+}
+
+static bool slower(const UnitStats * a, const UnitStats * b) {
+    return unitTotal(*a) > unitTotal(*b);
+}
+
+static std::string seconds(uint64_t us) {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(3) << us / 1e6;
+    return out.str();
+}
+
+void RunStats::report(std::ostream & out) const {
+    uint64_t phases[UnitStats::PHASE_COUNT] = { 0 };
+    std::map<std::string, uint64_t> dies;
+    uint64_t declarations = 0, types = 0, dieCount = 0;
+    std::vector<const UnitStats *> slowest;
+    BOOST_FOREACH(const UnitStats & u, units) {
+        for(int p = 0; p < UnitStats::PHASE_COUNT; ++p) {
+            phases[p] += u.phaseTime[p];
+        }
+        for(std::map<std::string, uint64_t>::const_iterator it = u.dies.begin(); it != u.dies.end(); ++it) {
+            dies[it->first] += it->second;
+            dieCount += it->second;
+        }
+        declarations += u.declarations;
+        types += u.typesConverted;
+        slowest.push_back(&u);
+    }
+    std::sort(slowest.begin(), slowest.end(), slower);
+    if(slowest.size() > SLOWEST_SHOWN) {
+        slowest.resize(SLOWEST_SHOWN);
+    }
+
+    // Unit phases are summed over the workers, so with several jobs they
+    // add up to more than the wall time.
+    out << "Phase                 Time (s)" << std::endl;
+    out << "  " << std::left << std::setw(18) << "frontend" << std::right << std::setw(10) << seconds(frontendTime) << std::endl;
+    if(testsTime > 0) {
+        out << "  " << std::left << std::setw(18) << "AstTests" << std::right << std::setw(10) << seconds(testsTime) << std::endl;
+    }
+    for(int p = 0; p < UnitStats::PHASE_COUNT; ++p) {
+        out << "  " << std::left << std::setw(18) << UnitStats::phaseName(UnitStats::Phase(p)) << std::right << std::setw(10)
+            << seconds(phases[p]) << std::endl;
+    }
+    out << "  " << std::left << std::setw(18) << "write" << std::right << std::setw(10) << seconds(writeTime) << std::endl;
+    out << "  " << std::left << std::setw(18) << "wall" << std::right << std::setw(10) << seconds(microseconds() - started) << std::endl;
+
+    if(!slowest.empty()) {
+        out << "Slowest units (s)" << std::endl << "  ";
+        for(int p = 0; p < UnitStats::PHASE_COUNT; ++p) {
+            out << std::setw(10) << UnitStats::phaseName(UnitStats::Phase(p));
+        }
+        out << std::setw(10) << "total" << "  unit" << std::endl;
+        BOOST_FOREACH(const UnitStats * u, slowest) {
+            out << "  ";
+            for(int p = 0; p < UnitStats::PHASE_COUNT; ++p) {
+                out << std::setw(10) << seconds(u->phaseTime[p]);
+            }
+            out << std::setw(10) << seconds(unitTotal(*u)) << "  " << u->unitName << std::endl;
+        }
+    }
+
+    out << "DIEs by tag" << std::endl;
+    for(std::map<std::string, uint64_t>::const_iterator it = dies.begin(); it != dies.end(); ++it) {
+        out << "  " << std::left << std::setw(18) << it->first << std::right << std::setw(10) << it->second << std::endl;
+    }
+    out << units.size() << " units converted, " << cachedUnits << " taken from the cache" << std::endl;
+    out << dieCount << " DIEs, " << declarations << " declarations emitted, " << types << " types converted, "
+        << bytesWritten << " bytes written" << std::endl;
+}
+
+static std::string jsonString(const std::string & s) {
+    std::string out = "\"";
+    BOOST_FOREACH(char c, s) {
+        if(c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if(static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+bool RunStats::writeJson(const std::string & path) const {
+    std::ofstream out(path.c_str());
+    if(!out) {
+        std::cerr << "ERROR: Could not write the statistics to " << path << std::endl;
+        return false;
+    }
+    // Times are in microseconds.
+    out << "{\n  \"wall\": " << microseconds() - started << ",\n  \"frontend\": " << frontendTime
+        << ",\n  \"astTests\": " << testsTime << ",\n  \"write\": " << writeTime
+        << ",\n  \"bytesWritten\": " << bytesWritten << ",\n  \"cachedUnits\": " << cachedUnits << ",\n  \"units\": [";
+    for(size_t i = 0; i < units.size(); ++i) {
+        const UnitStats & u = units[i];
+        out << (i == 0 ? "\n" : ",\n") << "    {\"name\": " << jsonString(u.unitName);
+        for(int p = 0; p < UnitStats::PHASE_COUNT; ++p) {
+            out << ", \"" << UnitStats::phaseName(UnitStats::Phase(p)) << "\": " << u.phaseTime[p];
+        }
+        out << ", \"declarations\": " << u.declarations << ", \"typesConverted\": " << u.typesConverted << ", \"dies\": {";
+        for(std::map<std::string, uint64_t>::const_iterator it = u.dies.begin(); it != u.dies.end(); ++it) {
+            out << (it == u.dies.begin() ? "" : ", ") << jsonString(it->first) << ": " << it->second;
+        }
+        out << "}}";
+    }
+    out << "\n  ]\n}\n";
+    return out.good();
+}
+
+static void traceEvent(std::ostream & out, bool & first, const TraceSpan & span, uint64_t origin) {
+    // Anything that began before the run did is shown at its start.
+    uint64_t start = span.start > origin ? span.start - origin : 0;
+    out << (first ? "\n" : ",\n") << "    {\"name\": " << jsonString(span.name) << ", \"cat\": " << jsonString(span.category)
+        << ", \"ph\": \"X\", \"ts\": " << start << ", \"dur\": " << span.duration << ", \"pid\": " << span.pid
+        << ", \"tid\": " << span.tid << "}";
+    first = false;
+}
+
+static void processName(std::ostream & out, bool & first, int pid, const std::string & name) {
+    out << (first ? "\n" : ",\n") << "    {\"name\": \"process_name\", \"ph\": \"M\", \"pid\": " << pid
+        << ", \"args\": {\"name\": " << jsonString(name) << "}}";
+    first = false;
+}
+
+bool RunStats::writeTrace(const std::string & path) const {
+    std::ofstream out(path.c_str());
+    if(!out) {
+        std::cerr << "ERROR: Could not write the trace to " << path << std::endl;
+        return false;
+    }
+    bool first = true;
+    std::set<int> workers;
+    int self = getpid();
+    out << "{\n  \"displayTimeUnit\": \"ms\",\n  \"traceEvents\": [";
+    processName(out, first, self, "undwarf");
+    BOOST_FOREACH(const TraceSpan & span, spans) {
+        traceEvent(out, first, span, started);
+    }
+    BOOST_FOREACH(const UnitStats & u, units) {
+        if(u.spans.empty()) {
+            continue;
+        }
+        // The unit as a whole, around its phases.
+        TraceSpan unit = u.spans.front();
+        uint64_t end = unit.start + unit.duration;
+        BOOST_FOREACH(const TraceSpan & span, u.spans) {
+            unit.start = std::min(unit.start, span.start);
+            end = std::max(end, span.start + span.duration);
+        }
+        unit.name = u.unitName;
+        unit.category = "unit";
+        unit.duration = end - unit.start;
+        traceEvent(out, first, unit, started);
+        BOOST_FOREACH(const TraceSpan & span, u.spans) {
+            traceEvent(out, first, span, started);
+        }
+        if(unit.pid != self && workers.insert(unit.pid).second) {
+            processName(out, first, unit.pid, "undwarf worker");
+        }
+    }
+    out << "\n  ]\n}\n";
+    return out.good();
+}
+
+void StatsSink::write(size_t unit, const std::string & encoded) {
+    UnitOutput output;
+    if(output.decode(encoded)) {
+        uint64_t bytes = output.header.size();
+        for(size_t i = 0; i < output.namespaces.size(); ++i) {
+            bytes += output.namespaces[i].second.size();
+        }
+        UnitStats unitStats;
+        bool known = !output.stats.empty() && unitStats.decode(output.stats);
+        unitStats.unitName = output.unitName;
+        stats.addUnit(known ? &unitStats : NULL, bytes);
+    }
+    uint64_t start = RunStats::microseconds();
+    sink.write(unit, encoded);
+    stats.addWrite(output.unitName, start, RunStats::microseconds());
+}
+
+bool StatsSink::finish() {
+    uint64_t start = RunStats::microseconds();
+    bool ok = sink.finish();
+    stats.addWrite(std::string(), start, RunStats::microseconds());
+    return ok;
+}
@@ -0,0 +1,136 @@
+#ifndef __RUNSTATS_H__
+#define __RUNSTATS_H__
+
+#include <stdint.h>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "outputSink.h"
+
+// A stretch of time for -undwarf:trace: what ran, in which process and
+// thread, from start for duration microseconds.
+struct TraceSpan {
+    std::string name;
+    std::string category;
+    uint64_t start;
+    uint64_t duration;
+    int pid;
+    int tid;
+};
+
+// What converting one compilation unit took, for -undwarf:stats. It is
+// filled in wherever the unit runs and travels back with its output.
+struct UnitStats {
+    enum Phase {
+        READ,           // reading the DIEs and building the DWARF IR
+        INDEX,          // indexing and annotating the constructs
+        TRAVERSAL,      // UndwarfTraversal
+        ORDER,          // attaching and ordering the declarations
+        VALIDATE,       // Validation::check
+        OUTPUT,         // unparsing
+        PHASE_COUNT
+    };
+
+    // Not encoded; the unit's output carries it.
+    std::string unitName;
+    // Microseconds spent in each phase
+    uint64_t phaseTime[PHASE_COUNT];
+    // DIEs by tag, as the construct's name without SgAsmDwarf
+    std::map<std::string, uint64_t> dies;
+    uint64_t declarations;
+    uint64_t typesConverted;
+    // With -undwarf:trace, each phase as it ran, and the outermost type
+    // conversions that took at least typeSpanMinimum microseconds (none
+    // if it is 0). Only the spans are encoded.
+    bool tracing;
+    uint64_t typeSpanMinimum;
+    unsigned typeDepth;
+    std::vector<TraceSpan> spans;
+
+    UnitStats();
+
+    static const char * phaseName(Phase p);
+
+    // Records spans from now on, in the calling process and thread.
+    void startTrace(uint64_t typeMinimum);
+    void addSpan(const std::string & name, const std::string & category, uint64_t start, uint64_t end);
+
+    std::string encode() const;
+    bool decode(const std::string & encoded);
+};
+
+// Adds the time it runs to a phase of stats: from construction, or the
+// last next(), until the next next(), stop() or destruction. Costs
+// nothing but a test when stats is NULL.
+class PhaseTimer {
+    public:
+        PhaseTimer(UnitStats * s, UnitStats::Phase p);
+        ~PhaseTimer() { stop(); };
+
+        // Stops timing the current phase and starts timing p.
+        void next(UnitStats::Phase p);
+        void stop();
+
+    private:
+        void add(uint64_t now);
+
+        UnitStats * stats;
+        UnitStats::Phase phase;
+        uint64_t start;
+        bool running;
+};
+
+// The totals of a run, kept in the main process.
+class RunStats {
+    public:
+        RunStats();
+
+        static uint64_t microseconds();
+
+        // Time spent before any unit was converted: the ROSE frontend and
+        // the checks on its output, or opening the binaries.
+        void addFrontend(uint64_t start, uint64_t end);
+        void addTests(uint64_t start, uint64_t end);
+
+        // A finished unit and the bytes written for it. Units taken from
+        // the cache have no stats.
+        void addUnit(const UnitStats * stats, uint64_t bytes);
+        void addWrite(const std::string & unitName, uint64_t start, uint64_t end);
+
+        // A table of the phases, the slowest units and the counts.
+        void report(std::ostream & out) const;
+        // The same, with every unit, as JSON. False if path can't be written.
+        bool writeJson(const std::string & path) const;
+        // Every span of the run as Chrome trace events, for chrome://tracing
+        // or Perfetto. False if path can't be written.
+        bool writeTrace(const std::string & path) const;
+
+    private:
+        uint64_t started;
+        uint64_t frontendTime;
+        uint64_t testsTime;
+        uint64_t writeTime;
+        uint64_t bytesWritten;
+        size_t cachedUnits;
+        std::vector<UnitStats> units;
+        // Spans of this process
+        std::vector<TraceSpan> spans;
+
+        void addSpan(const std::string & name, const std::string & category, uint64_t start, uint64_t end);
+};
+
+// Hands every unit on to another sink, adding its stats to a RunStats on
+// the way.
+class StatsSink : public UnitSink {
+    public:
+        StatsSink(UnitSink & s, RunStats & r) : sink(s), stats(r) {};
+        virtual void write(size_t unit, const std::string & encoded);
+        virtual bool finish();
+
+    private:
+        UnitSink & sink;
+        RunStats & stats;
+};
+
+#endif
@@ -0,0 +1,102 @@
+#ifndef __SCOPEQUEUE_H__
+#define __SCOPEQUEUE_H__
+
+#include <list>
+#include <vector>
+#include <boost/unordered_map.hpp>
+
+// Declarations waiting to be attached to the scopes they were converted
+// in. SageInterface's insertion functions search the scope's statement
+// list, and prepending shifts all of it, so filling a scope that way is
+// quadratic in its size. Here each scope gets a linked list, and the
+// position of every queued statement is kept, so appending, prepending
+// and inserting before a queued statement are all constant time. The
+// lists are attached in one go with flush().
+//
+// Statements get their parent as soon as they are queued, since ROSE
+// finds a statement's scope through it.
+template <class Scope, class Statement>
+class ScopeQueue {
+    public:
+        ScopeQueue() : lastScope(NULL), lastStatements(NULL) {};
+
+        void append(Scope * scope, Statement * s) {
+            Statements & list = statementsOf(scope);
+            queued(scope, s, list.insert(list.end(), s));
+        };
+
+        void prepend(Scope * scope, Statement * s) {
+            Statements & list = statementsOf(scope);
+            queued(scope, s, list.insert(list.begin(), s));
+        };
+
+        // Queues s just before target, or at the front of scope if target
+        // isn't queued there.
+        void insertBefore(Scope * scope, Statement * target, Statement * s) {
+            Statements & list = statementsOf(scope);
+            typename Positions::iterator p = positions.find(target);
+            typename Statements::iterator at = list.begin();
+            if(p != positions.end() && p->second.first == scope) {
+                at = p->second.second;
+            }
+            queued(scope, s, list.insert(at, s));
+        };
+
+        bool empty() const { return positions.empty(); };
+
+        // Hands every queued statement to attach(scope, statement), scope
+        // by scope in the order the scopes were first queued to and in
+        // order within each, then empties the queue. Returns how many
+        // statements were attached.
+        template <class Attach>
+        size_t flush(Attach attach) {
+            size_t count = 0;
+            for(size_t i = 0; i < order.size(); ++i) {
+                Statements & list = scopes[order[i]];
+                for(typename Statements::iterator s = list.begin(); s != list.end(); ++s) {
+                    attach(order[i], *s);
+                    ++count;
+                }
+            }
+            scopes.clear();
+            positions.clear();
+            order.clear();
+            lastScope = NULL;
+            lastStatements = NULL;
+            return count;
+        };
+
+    private:
+        typedef std::list<Statement *> Statements;
+        typedef boost::unordered_map<Statement *, std::pair<Scope *, typename Statements::iterator> > Positions;
+
+        boost::unordered_map<Scope *, Statements> scopes;
+        Positions positions;
+        std::vector<Scope *> order;
+        // Declarations come in runs for one scope, as in TypeMemo.
+        Scope * lastScope;
+        Statements * lastStatements;
+
+        Statements & statementsOf(Scope * scope) {
+            if(lastStatements == NULL || scope != lastScope) {
+                typename boost::unordered_map<Scope *, Statements>::iterator s = scopes.find(scope);
+                if(s == scopes.end()) {
+                    s = scopes.insert(std::make_pair(scope, Statements())).first;
+                    order.push_back(scope);
+                }
+                lastStatements = &s->second;
+                lastScope = scope;
+            }
+            return *lastStatements;
+        };
+
+        void queued(Scope * scope, Statement * s, typename Statements::iterator at) {
+            positions[s] = std::make_pair(scope, at);
+            s->set_parent(scope);
+        };
+
+        ScopeQueue(ScopeQueue const &);
+        void operator=(ScopeQueue const &);
+};
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef __STRINGREF_H__
+#define __STRINGREF_H__
+
+#include <cstring>
+#include <string>
+#include <ostream>
+
+// A non-owning view of a NUL-terminated string, usually one living in a
+// mapped .debug_str section. Only the pointer is stored; the string is
+// copied only when something actually needs a std::string.
+class StringRef {
+    public:
+        StringRef() : ptr("") {};
+        explicit StringRef(const char * s) : ptr(s == NULL ? "" : s) {};
+
+        const char * c_str() const { return ptr; };
+        size_t size() const { return strlen(ptr); };
+        bool empty() const { return *ptr == '\0'; };
+        std::string str() const { return std::string(ptr); };
+
+        bool operator==(const StringRef & o) const { return ptr == o.ptr || strcmp(ptr, o.ptr) == 0; };
+        bool operator!=(const StringRef & o) const { return !(*this == o); };
+        bool operator==(const char * s) const { return strcmp(ptr, s) == 0; };
+        bool operator<(const StringRef & o) const { return strcmp(ptr, o.ptr) < 0; };
+
+    private:
+        const char * ptr;
+};
+
+inline std::ostream & operator<<(std::ostream & out, const StringRef & s) {
+    return out << s.c_str();
+}
+
+#endif
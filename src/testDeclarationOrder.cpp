@@ -0,0 +1,82 @@
+// Checks that DeclarationOrder deletes the forward declarations it drops
+// and leaves nothing pointing at them. The global scope holds
+//
+//   struct A { B * b; };  struct B { A * a; };  struct A;  struct B;
+//
+// where the bare declarations were made first, so each is its record's
+// first nondefining declaration, and the one its symbol and type point
+// at. Sorting moves B's bare declaration ahead of A and drops A's.
+//
+//   testDeclarationOrder
+
+#include <cstdio>
+#include <vector>
+
+#include "rose.h"
+#include "declarationOrder.h"
+
+static SgClassDeclaration * record(const char * name, SgGlobal * global, SgClassDeclaration * & forward) {
+    forward = SageBuilder::buildNondefiningClassDeclaration_nfi(SgName(name), SgClassDeclaration::e_struct, global);
+    SageInterface::setOneSourcePositionForTransformation(forward);
+    SgClassDeclaration * decl = SageBuilder::buildClassDeclaration_nfi(SgName(name), SgClassDeclaration::e_struct, global, forward);
+    SageInterface::setOneSourcePositionForTransformation(decl);
+    return decl;
+}
+
+static void pointTo(SgClassDeclaration * from, const char * name, SgClassDeclaration * to) {
+    SgClassDefinition * body = from->get_definition();
+    SgVariableDeclaration * member = SageBuilder::buildVariableDeclaration(SgName(name),
+            SageBuilder::buildPointerType(to->get_type()), NULL, body);
+    SageInterface::appendStatement(member, body);
+}
+
+int main() {
+    SgSourceFile * file = new SgSourceFile();
+    file->set_Cxx_only(true);
+    SgGlobal * global = new SgGlobal();
+    file->set_globalScope(global);
+    global->set_parent(file);
+    SageInterface::setSourcePositionForTransformation(global);
+
+    SgClassDeclaration * forwardA = NULL;
+    SgClassDeclaration * forwardB = NULL;
+    SgClassDeclaration * a = record("A", global, forwardA);
+    SgClassDeclaration * b = record("B", global, forwardB);
+    pointTo(a, "b", b);
+    pointTo(b, "a", a);
+    SageInterface::appendStatement(a, global);
+    SageInterface::appendStatement(b, global);
+    SageInterface::appendStatement(forwardA, global);
+    SageInterface::appendStatement(forwardB, global);
+
+    size_t dropped = DeclarationOrder::sort(global);
+    // forwardA has been deleted; it is only compared against from here on.
+    const SgNode * gone = forwardA;
+
+    SgDeclarationStatementPtrList & list = global->get_declarations();
+    if(dropped != 1 || list.size() != 3 || list[0] != forwardB || list[1] != a || list[2] != b) {
+        fprintf(stderr, "ERROR: expected struct B; struct A {...}; struct B {...}; with one declaration dropped\n");
+        return 1;
+    }
+    std::vector<SgNode *> nodes = NodeQuery::querySubTree(global, V_SgNode);
+    for(size_t i = 0; i < nodes.size(); ++i) {
+        SgNode * n = nodes[i];
+        if(n == gone || n->get_parent() == gone) {
+            fprintf(stderr, "ERROR: the dropped declaration is still in the tree\n");
+            return 1;
+        }
+        SgDeclarationStatement * d = isSgDeclarationStatement(n);
+        if(d != NULL && (d->get_firstNondefiningDeclaration() == gone || d->get_definingDeclaration() == gone)) {
+            fprintf(stderr, "ERROR: %s still refers to the dropped declaration\n", n->class_name().c_str());
+            return 1;
+        }
+    }
+    SgClassSymbol * symbol = global->lookup_class_symbol(SgName("A"));
+    if(symbol == NULL || symbol->get_declaration() == gone || a->get_type()->get_declaration() == gone) {
+        fprintf(stderr, "ERROR: A's symbol or type still refers to the dropped declaration\n");
+        return 1;
+    }
+
+    printf("OK: dropped %lu forward declaration and nothing refers to it\n", (unsigned long)dropped);
+    return 0;
+}
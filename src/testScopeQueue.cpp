@@ -0,0 +1,112 @@
+// Checks that ScopeQueue puts statements where the SageInterface calls
+// it replaced would: insertStatementAfterLastDeclaration,
+// prependStatement and insertStatementBefore, modelled here on a plain
+// vector of statements. The scope is a namespace with the given number
+// of members (10,000 by default); every tenth member needs a class that
+// hasn't been declared yet, which gets a forward declaration at the front
+// and its definition just before the member, as convertType does. This
+// only compares the order; it says nothing about how fast ROSE's own
+// calls are.
+//
+//   testScopeQueue [member count]
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "scopeQueue.h"
+
+struct FakeScope;
+
+struct FakeStatement {
+    FakeScope * parent;
+    bool declaration;
+
+    FakeStatement() : parent(NULL), declaration(true) {};
+    void set_parent(FakeScope * p) { parent = p; };
+};
+
+struct FakeScope {
+    std::vector<FakeStatement *> statements;
+};
+
+// What insertStatementAfterLastDeclaration does: look through the list
+// for the last declaration, then insert after it.
+static void insertAfterLastDeclaration(FakeScope & scope, FakeStatement * s) {
+    size_t last = 0;
+    for(size_t i = 0; i < scope.statements.size(); ++i) {
+        if(scope.statements[i]->declaration) {
+            last = i + 1;
+        }
+    }
+    scope.statements.insert(scope.statements.begin() + last, s);
+    s->set_parent(&scope);
+}
+
+static void prependStatement(FakeScope & scope, FakeStatement * s) {
+    scope.statements.insert(scope.statements.begin(), s);
+    s->set_parent(&scope);
+}
+
+static void insertStatementBefore(FakeScope & scope, FakeStatement * target, FakeStatement * s) {
+    size_t i = 0;
+    while(i < scope.statements.size() && scope.statements[i] != target) {
+        ++i;
+    }
+    scope.statements.insert(scope.statements.begin() + i, s);
+    s->set_parent(&scope);
+}
+
+struct Attach {
+    void operator()(FakeScope * scope, FakeStatement * s) const {
+        scope->statements.push_back(s);
+    };
+};
+
+int main(int argc, char * argv[]) {
+    size_t count = argc > 1 ? strtoul(argv[1], NULL, 10) : 10000;
+    if(count == 0) {
+        fprintf(stderr, "usage: %s [member count]\n", argv[0]);
+        return 1;
+    }
+
+    // Per member: the member itself, and for every tenth a forward
+    // declaration and a definition.
+    std::vector<FakeStatement> statements(count * 3);
+
+    FakeScope direct;
+    for(size_t i = 0; i < count; ++i) {
+        FakeStatement * member = &statements[3 * i];
+        insertAfterLastDeclaration(direct, member);
+        if(i % 10 == 0) {
+            insertStatementBefore(direct, member, &statements[3 * i + 1]);
+            prependStatement(direct, &statements[3 * i + 2]);
+        }
+    }
+    FakeScope queued;
+    ScopeQueue<FakeScope, FakeStatement> queue;
+    for(size_t i = 0; i < count; ++i) {
+        FakeStatement * member = &statements[3 * i];
+        queue.append(&queued, member);
+        if(i % 10 == 0) {
+            queue.insertBefore(&queued, member, &statements[3 * i + 1]);
+            queue.prepend(&queued, &statements[3 * i + 2]);
+        }
+    }
+    queue.flush(Attach());
+
+    if(direct.statements != queued.statements) {
+        fprintf(stderr, "ERROR: the queue put the statements in a different order\n");
+        return 1;
+    }
+    // Both fill in the parent; the queue does it when a statement is queued.
+    for(size_t i = 0; i < queued.statements.size(); ++i) {
+        if(queued.statements[i]->parent != &queued) {
+            fprintf(stderr, "ERROR: statement %lu has the wrong parent\n", (unsigned long)i);
+            return 1;
+        }
+    }
+
+    printf("OK: %lu members, %lu statements in the same order\n", (unsigned long)count, (unsigned long)queued.statements.size());
+    return 0;
+}
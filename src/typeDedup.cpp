@@ -0,0 +1,204 @@
+#include "typeDedup.h"
+#include "dwarf.h"
+
+namespace {
+
+// Strings are hashed with their terminator, so that ("ab", "c") and
+// ("a", "bc") differ.
+inline void add(ContentHasher & h, const StringRef & s) {
+    h.update(s.c_str(), s.size() + 1);
+}
+
+inline void add(ContentHasher & h, const ContentDigest & d) {
+    h.update(d.high);
+    h.update(d.low);
+}
+
+bool isNamedType(const DwarfDie & d) {
+    switch(d.tag) {
+        case DW_TAG_structure_type:
+        case DW_TAG_class_type:
+        case DW_TAG_union_type:
+        case DW_TAG_enumeration_type:
+        case DW_TAG_typedef:
+            return !d.name.empty();
+        default:
+            return false;
+    }
+}
+
+bool isScope(const DwarfDie & d) {
+    switch(d.tag) {
+        case DW_TAG_namespace:
+        case DW_TAG_structure_type:
+        case DW_TAG_class_type:
+        case DW_TAG_union_type:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Hashes the DIEs of one unit; results are kept per DIE.
+class UnitHasher {
+    public:
+        explicit UnitHasher(const DwarfUnit & u) : unit(u), hashes(u.dies.size()), state(u.dies.size(), TODO) {};
+
+        // The digest of a type definition including its enclosing scopes.
+        ContentDigest typeHash(uint32_t i) {
+            ContentHasher h;
+            add(h, scopeHash(unit.dies[i].parent));
+            add(h, full(i));
+            return h.digest();
+        };
+
+    private:
+        enum State { TODO, BUSY, DONE };
+
+        const DwarfUnit & unit;
+        std::vector<ContentDigest> hashes;
+        std::vector<char> state;
+
+        ContentDigest scopeHash(uint32_t i) {
+            ContentHasher h;
+            for(; i != DwarfDie::NONE && isScope(unit.dies[i]); i = unit.dies[i].parent) {
+                h.update(static_cast<uint64_t>(unit.dies[i].tag));
+                add(h, unit.dies[i].name);
+            }
+            return h.digest();
+        };
+
+        ContentDigest nominal(uint32_t i) {
+            const DwarfDie & d = unit.dies[i];
+            ContentHasher h;
+            add(h, scopeHash(d.parent));
+            h.update(static_cast<uint64_t>(d.tag));
+            add(h, d.name);
+            return h.digest();
+        };
+
+        // Digest of a DIE, everything it refers to and all its children.
+        ContentDigest full(uint32_t i) {
+            if(state[i] == DONE) {
+                return hashes[i];
+            }
+            if(state[i] == BUSY) {
+                // Only reachable through a cycle; fall back to the name.
+                return nominal(i);
+            }
+            state[i] = BUSY;
+
+            const DwarfDie & d = unit.dies[i];
+            ContentHasher h;
+            h.update(static_cast<uint64_t>(d.tag));
+            add(h, d.name);
+            h.update(d.byteSize);
+            h.update(d.bitSize);
+            h.update(d.memberOffset);
+            h.update(d.constValue);
+            h.update(d.hasUpperBound ? d.upperBound : ~static_cast<uint64_t>(0));
+            h.update(static_cast<uint64_t>((d.accessibility << 8) | d.virtuality));
+            h.update(static_cast<uint64_t>((d.artificial ? 1 : 0) | (d.declaration ? 2 : 0)));
+            if(d.hasTypeRef) {
+                bool indirect = d.tag == DW_TAG_pointer_type || d.tag == DW_TAG_reference_type
+                    || d.tag == DW_TAG_rvalue_reference_type || d.tag == DW_TAG_ptr_to_member_type;
+                add(h, refHash(d.typeRef, indirect));
+            }
+            for(uint32_t c = d.firstChild; c != DwarfDie::NONE; c = unit.dies[c].nextSibling) {
+                add(h, full(c));
+            }
+
+            hashes[i] = h.digest();
+            state[i] = DONE;
+            return hashes[i];
+        };
+
+        ContentDigest refHash(uint64_t offset, bool indirect) {
+            uint32_t j = unit.indexOf(offset);
+            if(j == DwarfDie::NONE) {
+                return ContentDigest();
+            }
+            if(!indirect) {
+                return full(j);
+            }
+            // Look through qualifiers to find what the pointer names.
+            ContentHasher h;
+            while(unit.dies[j].tag == DW_TAG_const_type || unit.dies[j].tag == DW_TAG_volatile_type
+                    || unit.dies[j].tag == DW_TAG_restrict_type) {
+                h.update(static_cast<uint64_t>(unit.dies[j].tag));
+                if(!unit.dies[j].hasTypeRef) {
+                    return h.digest();
+                }
+                j = unit.indexOf(unit.dies[j].typeRef);
+                if(j == DwarfDie::NONE) {
+                    return h.digest();
+                }
+            }
+            add(h, isNamedType(unit.dies[j]) ? nominal(j) : full(j));
+            return h.digest();
+        };
+};
+
+// The index just past the subtree rooted at i.
+uint32_t subtreeEnd(const DwarfUnit & unit, uint32_t i) {
+    uint32_t end = i + 1;
+    while(end < unit.dies.size() && unit.dies[end].depth > unit.dies[i].depth) {
+        ++end;
+    }
+    return end;
+}
+
+void appendSubtree(const DwarfUnit & unit, uint32_t i, std::vector<uint64_t> & shared) {
+    uint32_t end = subtreeEnd(unit, i);
+    for(uint32_t k = i; k < end; ++k) {
+        shared.push_back(unit.dies[k].offset);
+    }
+}
+
+}
+
+void TypeDedup::markShared(const DwarfUnit & unit, std::vector<uint64_t> & shared) {
+    if(unit.dies.empty()) {
+        return;
+    }
+
+    // How often each DIE is referred to, so that an unnamed type used
+    // only by a shared typedef can be dropped along with it.
+    std::vector<uint32_t> refCount(unit.dies.size(), 0);
+    for(size_t i = 0; i < unit.dies.size(); ++i) {
+        if(unit.dies[i].hasTypeRef) {
+            uint32_t j = unit.indexOf(unit.dies[i].typeRef);
+            if(j != DwarfDie::NONE) {
+                ++refCount[j];
+            }
+        }
+    }
+
+    UnitHasher hasher(unit);
+    for(uint32_t i = 1; i < unit.dies.size(); ++i) {
+        const DwarfDie & d = unit.dies[i];
+        if(!isNamedType(d) || d.declaration) {
+            continue;
+        }
+        const DwarfDie & parent = unit.dies[d.parent];
+        if(parent.tag != DW_TAG_compile_unit && parent.tag != DW_TAG_partial_unit
+                && parent.tag != DW_TAG_namespace) {
+            continue;
+        }
+
+        if(seen.insert(hasher.typeHash(i)).second) {
+            ++distinct;
+            continue;
+        }
+        ++duplicates;
+        appendSubtree(unit, i, shared);
+
+        if(d.tag == DW_TAG_typedef && d.hasTypeRef) {
+            uint32_t j = unit.indexOf(d.typeRef);
+            if(j != DwarfDie::NONE && refCount[j] == 1 && unit.dies[j].name.empty()
+                    && unit.dies[j].parent == d.parent) {
+                appendSubtree(unit, j, shared);
+            }
+        }
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef __TYPEDEDUP_H__
+#define __TYPEDEDUP_H__
+
+#include <stdint.h>
+#include <set>
+#include <vector>
+#include "dwarfReader.h"
+#include "contentHash.h"
+
+// Finds type definitions that an earlier compilation unit already
+// defined, so that each distinct type is written out only once.
+//
+// Types are compared by a 128-bit structural digest of their tag,
+// qualified name, size, and every member's name, offset and type; with
+// 128 bits, two distinct types won't collide. Member types are hashed
+// recursively, except that a named type reached through a pointer or
+// reference is hashed by its name alone, which keeps recursive types
+// finite and matches how C and C++ compare them. Only named types at
+// namespace scope are considered; nested types go along with the type
+// that contains them.
+class TypeDedup {
+    public:
+        TypeDedup() : distinct(0), duplicates(0) {};
+
+        // Records the types unit defines and appends to shared the
+        // offsets of every DIE belonging to a definition seen before.
+        void markShared(const DwarfUnit & unit, std::vector<uint64_t> & shared);
+
+        // Number of distinct types seen, and of definitions found to
+        // repeat one of them.
+        size_t distinctTypes() const { return distinct; };
+        size_t sharedDefinitions() const { return duplicates; };
+
+    private:
+        std::set<ContentDigest> seen;
+        size_t distinct;
+        size_t duplicates;
+};
+
+#endif
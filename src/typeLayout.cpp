@@ -0,0 +1,185 @@
+#include "typeLayout.h"
+#include "dwarf.h"
+#include <sstream>
+#include <boost/lexical_cast.hpp>
+
+#ifndef DW_TAG_rvalue_reference_type
+#define DW_TAG_rvalue_reference_type    0x42
+#endif
+
+// Type chains are short in practice; anything deeper is a cycle in
+// broken input.
+static const int MAX_DEPTH = 32;
+
+static uint32_t referenced(const DwarfUnit & unit, uint32_t index) {
+    const DwarfDie & die = unit.dies[index];
+    return die.hasTypeRef ? unit.indexOf(die.typeRef) : DwarfDie::NONE;
+}
+
+static std::string typeName(const DwarfUnit & unit, uint32_t index, int depth) {
+    if(index == DwarfDie::NONE || index >= unit.dies.size()) {
+        return "void";
+    }
+    if(depth > MAX_DEPTH) {
+        return "...";
+    }
+    const DwarfDie & die = unit.dies[index];
+    uint32_t target = referenced(unit, index);
+    switch(die.tag) {
+        case DW_TAG_pointer_type:
+            return typeName(unit, target, depth + 1) + " *";
+        case DW_TAG_reference_type:
+            return typeName(unit, target, depth + 1) + " &";
+        case DW_TAG_rvalue_reference_type:
+            return typeName(unit, target, depth + 1) + " &&";
+        case DW_TAG_const_type:
+            return typeName(unit, target, depth + 1) + " const";
+        case DW_TAG_volatile_type:
+            return typeName(unit, target, depth + 1) + " volatile";
+        case DW_TAG_restrict_type:
+            return typeName(unit, target, depth + 1) + " restrict";
+        case DW_TAG_array_type: {
+            std::string name = typeName(unit, target, depth + 1);
+            for(uint32_t i = die.firstChild; i != DwarfDie::NONE; i = unit.dies[i].nextSibling) {
+                if(unit.dies[i].tag == DW_TAG_subrange_type) {
+                    name += unit.dies[i].hasUpperBound ? "[" + boost::lexical_cast<std::string>(unit.dies[i].upperBound + 1) + "]" : "[]";
+                }
+            }
+            return name;
+        }
+        case DW_TAG_subroutine_type: {
+            std::string name = typeName(unit, target, depth + 1) + " (";
+            bool first = true;
+            for(uint32_t i = die.firstChild; i != DwarfDie::NONE; i = unit.dies[i].nextSibling) {
+                if(unit.dies[i].tag == DW_TAG_formal_parameter) {
+                    name += (first ? "" : ", ") + typeName(unit, referenced(unit, i), depth + 1);
+                    first = false;
+                } else if(unit.dies[i].tag == DW_TAG_unspecified_parameters) {
+                    name += first ? "..." : ", ...";
+                    first = false;
+                }
+            }
+            return name + ")";
+        }
+        case DW_TAG_structure_type:
+            return die.name.empty() ? "struct <anonymous>" : die.name.str();
+        case DW_TAG_class_type:
+            return die.name.empty() ? "class <anonymous>" : die.name.str();
+        case DW_TAG_union_type:
+            return die.name.empty() ? "union <anonymous>" : die.name.str();
+        case DW_TAG_enumeration_type:
+            return die.name.empty() ? "enum <anonymous>" : die.name.str();
+        default:
+            return die.name.empty() ? "<unknown>" : die.name.str();
+    }
+}
+
+std::string TypeLayout::typeName(const DwarfUnit & unit, uint32_t index) {
+    return ::typeName(unit, index, 0);
+}
+
+static uint64_t typeSize(const DwarfUnit & unit, uint32_t index, int depth) {
+    if(index == DwarfDie::NONE || index >= unit.dies.size() || depth > MAX_DEPTH) {
+        return 0;
+    }
+    const DwarfDie & die = unit.dies[index];
+    if(die.byteSize != 0) {
+        return die.byteSize;
+    }
+    switch(die.tag) {
+        case DW_TAG_pointer_type:
+        case DW_TAG_reference_type:
+        case DW_TAG_rvalue_reference_type:
+            return unit.header.addressSize;
+        case DW_TAG_array_type: {
+            uint64_t size = typeSize(unit, referenced(unit, index), depth + 1);
+            for(uint32_t i = die.firstChild; i != DwarfDie::NONE; i = unit.dies[i].nextSibling) {
+                if(unit.dies[i].tag == DW_TAG_subrange_type) {
+                    size *= unit.dies[i].hasUpperBound ? unit.dies[i].upperBound + 1 : 0;
+                }
+            }
+            return size;
+        }
+        case DW_TAG_typedef:
+        case DW_TAG_const_type:
+        case DW_TAG_volatile_type:
+        case DW_TAG_restrict_type:
+            return typeSize(unit, referenced(unit, index), depth + 1);
+        default:
+            return 0;
+    }
+}
+
+uint64_t TypeLayout::typeSize(const DwarfUnit & unit, uint32_t index) {
+    return ::typeSize(unit, index, 0);
+}
+
+// Where a bit-field starts, in bits from the start of the object. DWARF
+// 2/3 give the storage unit's offset and count from its most significant
+// bit, which is at the end on a little-endian machine. False if neither
+// form is there.
+static bool bitPosition(const DwarfUnit & unit, const DwarfDie & member, uint32_t type, uint64_t & bit) {
+    if(member.hasDataBitOffset) {
+        bit = member.bitOffset;
+        return true;
+    }
+    if(!member.hasBitOffset) {
+        return false;
+    }
+    uint64_t storage = 8 * (member.byteSize != 0 ? member.byteSize : TypeLayout::typeSize(unit, type));
+    // The sections are read in host byte order.
+    const uint16_t probe = 1;
+    if(*reinterpret_cast<const unsigned char *>(&probe) == 1) {
+        if(member.bitOffset + member.bitSize > storage) {
+            return false;
+        }
+        bit = 8 * member.memberOffset + storage - member.bitOffset - member.bitSize;
+    } else {
+        bit = 8 * member.memberOffset + member.bitOffset;
+    }
+    return true;
+}
+
+bool TypeLayout::describe(const DwarfUnit & unit, uint32_t index, const std::string & name, std::string & out) {
+    if(index >= unit.dies.size()) {
+        return false;
+    }
+    const DwarfDie & die = unit.dies[index];
+    const char * kind = NULL;
+    switch(die.tag) {
+        case DW_TAG_structure_type: kind = "struct"; break;
+        case DW_TAG_class_type: kind = "class"; break;
+        case DW_TAG_union_type: kind = "union"; break;
+        default:
+            return false;
+    }
+
+    std::ostringstream text;
+    text << kind << " " << name << " size " << die.byteSize << (die.declaration ? " (declaration only)" : "") << "\n";
+    for(uint32_t i = die.firstChild; i != DwarfDie::NONE; i = unit.dies[i].nextSibling) {
+        const DwarfDie & member = unit.dies[i];
+        if(member.tag != DW_TAG_member && member.tag != DW_TAG_inheritance) {
+            continue;
+        }
+        // Static members have no place in the object.
+        if(member.tag == DW_TAG_member && member.declaration) {
+            continue;
+        }
+        uint32_t type = referenced(unit, i);
+        uint64_t bit = 0;
+        if(member.bitSize != 0 && bitPosition(unit, member, type, bit)) {
+            text << "  bit " << bit << " bits " << member.bitSize;
+        } else if(member.bitSize != 0) {
+            text << "  bits " << member.bitSize;
+        } else {
+            text << "  offset " << member.memberOffset << " size " << TypeLayout::typeSize(unit, type);
+        }
+        if(member.tag == DW_TAG_inheritance) {
+            text << " base " << TypeLayout::typeName(unit, type) << "\n";
+        } else {
+            text << " " << TypeLayout::typeName(unit, type) << " " << (member.name.empty() ? "<anonymous>" : member.name.str()) << "\n";
+        }
+    }
+    out = text.str();
+    return true;
+}
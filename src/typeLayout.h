@@ -0,0 +1,27 @@
+#ifndef __TYPELAYOUT_H__
+#define __TYPELAYOUT_H__
+
+#include <stdint.h>
+#include <string>
+#include "dwarfReader.h"
+
+// Describes types straight from the DIE records, without converting
+// anything: what a debugger would want to know about a structure's
+// layout.
+namespace TypeLayout {
+    // The C spelling of the type at index in unit, with qualifiers
+    // after what they qualify: "char const *", "int[4]". DwarfDie::NONE
+    // is void.
+    std::string typeName(const DwarfUnit & unit, uint32_t index);
+
+    // The size in bytes of the type at index, or 0 if it isn't known.
+    uint64_t typeSize(const DwarfUnit & unit, uint32_t index);
+
+    // One line for the structure, class or union at index, called name,
+    // with its size, then one per base class and data member with its
+    // offset, size and type (or the bit it starts at and its width, for
+    // a bit-field). False if index isn't such a type.
+    bool describe(const DwarfUnit & unit, uint32_t index, const std::string & name, std::string & out);
+}
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef __TYPEMEMO_H__
+#define __TYPEMEMO_H__
+
+#include "rose.h"
+#include <map>
+#include "dieIndex.h"
+
+// Remembers the SgType each DWARF type DIE was converted to, separately
+// for each scope it was converted in, so that a type referenced many
+// times is only converted once per scope. Lookups for the same scope
+// tend to come in runs (all members of one class, all parameters of one
+// function), so the last scope's table is kept at hand.
+class TypeMemo {
+    public:
+        TypeMemo() : lastScope(NULL), lastTypes(NULL), hitCount(0), missCount(0) {};
+
+        // NULL if the DIE at offset hasn't been converted in scope yet.
+        SgType * find(SgScopeStatement * scope, uint64_t offset) {
+            SgType ** t = typesFor(scope).find(offset);
+            if(t == NULL) {
+                ++missCount;
+                return NULL;
+            }
+            ++hitCount;
+            return *t;
+        };
+
+        void insert(SgScopeStatement * scope, uint64_t offset, SgType * type) {
+            typesFor(scope).insert(offset, type);
+        };
+
+        size_t hits() const { return hitCount; };
+        size_t misses() const { return missCount; };
+
+    private:
+        std::map<SgScopeStatement *, OffsetIndex<SgType *> > scopes;
+        SgScopeStatement * lastScope;
+        OffsetIndex<SgType *> * lastTypes;
+        size_t hitCount;
+        size_t missCount;
+
+        OffsetIndex<SgType *> & typesFor(SgScopeStatement * scope) {
+            if(lastTypes == NULL || scope != lastScope) {
+                lastTypes = &scopes[scope];
+                lastScope = scope;
+            }
+            return *lastTypes;
+        };
+};
+
+#endif
@@ -3,7 +3,7 @@
 #include <string>
 #include <boost/algorithm/string/predicate.hpp>
 
-SgType * TypeTable::createType(VariantT t) {
+SgType * TypeTable::createType(VariantT t) const {
     switch(t) {  
         case V_SgTypeBool:
             return SageBuilder::buildBoolType();
@@ -53,24 +53,26 @@ SgType * TypeTable::createType(VariantT t) {
     }
 }
 
-std::string TypeTable::typeToName(VariantT t) {
-    if(typeMap.count(t) > 0) {
-        return typeMap[t];
+std::string TypeTable::typeToName(VariantT t) const {
+    std::map<VariantT, std::string>::const_iterator it = typeMap.find(t);
+    if(it != typeMap.end()) {
+        return it->second;
     } else {
         return "V_SgTypeUnknown";
     }
 }
 
-VariantT TypeTable::nameToType(const std::string & name) {
-    if(nameMap.count(name) > 0) {
-        return nameMap[name];
+VariantT TypeTable::nameToType(const std::string & name) const {
+    std::map<std::string, VariantT>::const_iterator it = nameMap.find(name);
+    if(it != nameMap.end()) {
+        return it->second;
     }  else {
         std::cerr << "WARNING: Can't identify type " << name << std::endl;
     }
     return V_SgTypeUnknown;
 }
 
-SgType * TypeTable::createType(const std::string & name) {
+SgType * TypeTable::createType(const std::string & name) const {
     if(boost::starts_with(name, "complex ")) {
         std::string subtype = name.substr(8, std::string::npos);
         return SageBuilder::buildComplexType(createType(nameToType(subtype)));
@@ -4,6 +4,9 @@
 #include "rose.h"
 #include <string>
 
+// The tables are filled in by the constructor and only read afterwards,
+// so the instance can be shared by everything that converts units once
+// it has been created; undwarf creates it before starting any workers.
 class TypeTable {
 
     public:
@@ -12,12 +15,12 @@ class TypeTable {
             return instance;
         }
 
-        std::string typeToName(VariantT t) ;
+        std::string typeToName(VariantT t) const;
 
-        VariantT nameToType(const std::string & name) ;
+        VariantT nameToType(const std::string & name) const;
 
-        SgType * createType(VariantT v);
-        SgType * createType(const std::string & name);
+        SgType * createType(VariantT v) const;
+        SgType * createType(const std::string & name) const;
         
 
     private:
@@ -1,62 +1,144 @@
 #include "rose.h"
 
+#include <climits>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <iomanip>
 #include <string>
 #include <vector>
 #include <map>
+#include <set>
 #include <sstream>
 #include <utility>
+#include <algorithm>
 #include <boost/algorithm/string.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/foreach.hpp>
 #include <boost/tokenizer.hpp>
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/algorithm/string/predicate.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <sys/time.h>
 
 #include "typeTable.h"
 #include "DwarfROSEConverter.h"
 #include "attributes.h"
+#include "options.h"
+#include "elfFile.h"
+#include "dwarfReader.h"
+#include "dwarfBuilder.h"
+#include "typeDedup.h"
+#include "workerPool.h"
+#include "headerEmitter.h"
+#include "outputSink.h"
+#include "unitCache.h"
+#include "fileWatcher.h"
+#include "reachability.h"
+#include "unitFilter.h"
+#include "nameIndex.h"
+#include "queryServer.h"
+#include "typeLayout.h"
+#include "validation.h"
+#include "declarationOrder.h"
+#include "runStats.h"
     
 static TypeTable & typeTable = TypeTable::getInstance();
 
-static offsetMapType & constructOffsetMap(SgNode * top) {
-    offsetMapType * offsetMap = new offsetMapType();
+// Threads writing the files of a split output directory.
+static const unsigned OUTPUT_WRITERS = 4;
 
-    Rose_STL_Container<SgNode*> constructs = NodeQuery::querySubTree(top, V_SgAsmDwarfConstruct);
-    BOOST_FOREACH(SgNode * n, constructs) {
-        SgAsmDwarfConstruct * construct = isSgAsmDwarfConstruct(n);
-        ROSE_ASSERT(construct != NULL);
-        std::string offsetStr = "<" + boost::lexical_cast<std::string>(construct->get_offset()) + ">";
-        if(SageInterface::getProject()->get_verbose() > 0) {
-            std::string name = construct->get_name();
-            if(name.empty()) {
-                name = "<unnamed>";
-            }
-            std::cerr << construct->class_name() << " " << name << " is " << offsetStr << std::endl;
+// A reference to a construct the walk hasn't reached yet, filled in
+// once the whole unit is in the table.
+struct PendingRef {
+    uint32_t id;
+    uint64_t offset;
+    bool spec;
+
+    PendingRef(uint32_t i, uint64_t o, bool s) : id(i), offset(o), spec(s) {};
+};
+
+// Resolve a "<offset>" reference if its target is already in the table;
+// otherwise remember it. NULL for now if it's empty or not added yet.
+static SgAsmDwarfConstruct * resolveRef(DieTable & table, uint32_t id, const std::string & ref, bool spec,
+        std::vector<PendingRef> & pending) {
+    uint64_t offset;
+    if(!parseOffsetRef(ref, offset)) {
+        return NULL;
+    }
+    DieAnnotation * target = table.find(offset);
+    if(target == NULL) {
+        pending.push_back(PendingRef(id, offset, spec));
+        return NULL;
+    }
+    return target->construct;
+}
+
+static void indexConstruct(SgAsmDwarfConstruct * construct, DieTable & table, std::vector<PendingRef> & pending, bool verbose) {
+    if(verbose) {
+        std::string name = construct->get_name();
+        if(name.empty()) {
+            name = "<unnamed>";
+        }
+        std::cerr << construct->class_name() << " " << name << " is <" << construct->get_offset() << ">" << std::endl;
+    }
+    uint32_t id = table.add(construct);
+    // Copied out: adding the children may move the annotation.
+    SgAsmDwarfConstruct * type = resolveRef(table, id, construct->get_type_ref(), false, pending);
+    SgAsmDwarfConstruct * spec = resolveRef(table, id, construct->get_spec_ref(), true, pending);
+    table[id].type = type;
+    table[id].spec = spec;
+
+    SgAsmDwarfConstructList * children = construct->get_children();
+    if(children != NULL) {
+        BOOST_FOREACH(SgAsmDwarfConstruct * child, children->get_list()) {
+            indexConstruct(child, table, pending, verbose);
         }
-        (*offsetMap)[offsetStr] = construct;
-    }          
+    }
+}
 
-    return *offsetMap;
+// The number of constructs at and below c.
+static size_t countConstructs(SgAsmDwarfConstruct * c) {
+    size_t count = 1;
+    SgAsmDwarfConstructList * children = c->get_children();
+    if(children != NULL) {
+        BOOST_FOREACH(SgAsmDwarfConstruct * child, children->get_list()) {
+            count += countConstructs(child);
+        }
+    }
+    return count;
 }
 
-static void annotateDwarfConstructs(SgNode * top, offsetMapType & map) {
-    Rose_STL_Container<SgNode*> constructs = NodeQuery::querySubTree(top, V_SgAsmDwarfConstruct);
-    BOOST_FOREACH(SgNode * n, constructs) {
-        SgAsmDwarfConstruct * construct = isSgAsmDwarfConstruct(n);
-        OffsetAttribute * attr = new OffsetAttribute();
-        attr->add(construct);
-        if(map.count(construct->get_type_ref()) > 0) {
-            attr->type = map[construct->get_type_ref()];
-        } else if(SageInterface::getProject()->get_verbose() > 0 ) {
-            std::cerr << "Skipping annotation of " << construct->class_name() << " \"" <<  construct->get_name() << "\" because it has no entry in the offset map." << std::endl;
-        } 
+// Add every construct of the unit to the table and resolve its type and
+// specification references, in a single walk down the construct lists.
+// Most references point backwards and resolve on the spot; the rest are
+// patched once the walk is done.
+static void indexAndAnnotate(SgAsmDwarfCompilationUnit * unit, DieTable & table) {
+    const bool verbose = SageInterface::getProject()->get_verbose() > 0;
+    std::vector<PendingRef> pending;
+    indexConstruct(unit, table, pending, verbose);
 
-        if(map.count(construct->get_spec_ref()) > 0) {
-            attr->spec = map[construct->get_spec_ref()];
-        }   
+    BOOST_FOREACH(const PendingRef & ref, pending) {
+        DieAnnotation * target = table.find(ref.offset);
+        if(target == NULL) {
+            continue;
+        }
+        if(ref.spec) {
+            table[ref.id].spec = target->construct;
+        } else {
+            table[ref.id].type = target->construct;
+        }
+    }
+
+    if(verbose) {
+        for(size_t id = 0; id < table.size(); ++id) {
+            if(table[id].type == NULL) {
+                SgAsmDwarfConstruct * construct = table[id].construct;
+                std::cerr << "Skipping annotation of " << construct->class_name() << " \"" <<  construct->get_name() << "\" because it has no entry in the offset map." << std::endl;
+            }
+        }
     }
 }
 
@@ -101,6 +183,16 @@ InheritedAttribute UndwarfTraversal::evaluateInheritedAttribute(SgNode * n, Inhe
     SgDeclarationStatement * newDecl = NULL;
     SgScopeStatement * scope = (parentScope == NULL) ? global : parentScope;
 
+    // Parts of a type another compilation unit already defined only need
+    // enough converting to be referred to.
+    DieAnnotation * dieAttr = DieAnnotation::get(n);
+    bool shared = dieAttr != NULL && dieAttr->shared;
+
+    // Nothing below a pruned construct is converted.
+    if(a.pruned || (dieAttr != NULL && dieAttr->pruned)) {
+        return InheritedAttribute(parentScope, true);
+    }
+
     if(SageInterface::getProject()->get_verbose() > 0 && isSgAsmDwarfConstruct(n)) {
         SgAsmDwarfConstruct * dc = isSgAsmDwarfConstruct(n);
         std::cerr << "Processing " << dc->class_name() << " " << dc << " " << dc->get_name() << std::endl; 
@@ -117,7 +209,7 @@ InheritedAttribute UndwarfTraversal::evaluateInheritedAttribute(SgNode * n, Inhe
         case V_SgAsmDwarfSubprogram: {
             SgAsmDwarfSubprogram * sub = isSgAsmDwarfSubprogram(n);
             // Compiler-generated functions are marked artificial
-            if(!sub->get_artificiality()) {
+            if(!sub->get_artificiality() && !shared) {
                 SgFunctionDeclaration * funcDecl = DwarfROSE::convertSubprogram(sub, scope);
                 newDecl = funcDecl;
             }
@@ -131,7 +223,7 @@ InheritedAttribute UndwarfTraversal::evaluateInheritedAttribute(SgNode * n, Inhe
         };
 
         case V_SgAsmDwarfStructureType: {
-            OffsetAttribute * attr = OffsetAttribute::get(n);
+            DieAnnotation * attr = DieAnnotation::get(n);
             if(attr != NULL && attr->node != NULL && isSgClassDeclaration(attr->node)) {
                 parentScope = isSgClassDeclaration(attr->node)->get_definition();
             } else {
@@ -143,7 +235,7 @@ InheritedAttribute UndwarfTraversal::evaluateInheritedAttribute(SgNode * n, Inhe
         };
 
         case V_SgAsmDwarfUnionType: {
-            OffsetAttribute * attr = OffsetAttribute::get(n);
+            DieAnnotation * attr = DieAnnotation::get(n);
             if(attr != NULL && attr->node != NULL && isSgClassDeclaration(attr->node)) {
                 parentScope = isSgClassDeclaration(attr->node)->get_definition();
             } else {
@@ -155,7 +247,7 @@ InheritedAttribute UndwarfTraversal::evaluateInheritedAttribute(SgNode * n, Inhe
         };
 
         case V_SgAsmDwarfClassType: {
-            OffsetAttribute * attr = OffsetAttribute::get(n);
+            DieAnnotation * attr = DieAnnotation::get(n);
             if(attr != NULL && attr->node != NULL && isSgClassDeclaration(attr->node)) {
                 parentScope = isSgClassDeclaration(attr->node)->get_definition();
             } else {
@@ -170,7 +262,7 @@ InheritedAttribute UndwarfTraversal::evaluateInheritedAttribute(SgNode * n, Inhe
 
 
         case V_SgAsmDwarfNamespace: {
-            OffsetAttribute * attr = OffsetAttribute::get(n);
+            DieAnnotation * attr = DieAnnotation::get(n);
             SgAsmDwarfNamespace * ns = isSgAsmDwarfNamespace(n);
             std::string spec = ns->get_spec_ref();
             if(attr != NULL && attr->node != NULL && isSgNamespaceDeclarationStatement(attr->node)) {
@@ -185,7 +277,7 @@ InheritedAttribute UndwarfTraversal::evaluateInheritedAttribute(SgNode * n, Inhe
 
         case V_SgAsmDwarfMember: {
             SgAsmDwarfMember * mem = isSgAsmDwarfMember(n);
-            if(!mem->get_artificiality()) {
+            if(!mem->get_artificiality() && !shared) {
                 SgVariableDeclaration * varDecl = DwarfROSE::convertMember(mem, scope);
                 newDecl = varDecl;
             }
@@ -193,6 +285,9 @@ InheritedAttribute UndwarfTraversal::evaluateInheritedAttribute(SgNode * n, Inhe
         };
 
         case V_SgAsmDwarfInheritance: {
+            if(shared) {
+                break;
+            }
             SgBaseClass * baseClass = DwarfROSE::convertInheritance(isSgAsmDwarfInheritance(n), scope);
             SgClassDefinition * classDefn = isSgClassDefinition(scope);
             if(baseClass != NULL && classDefn != NULL) {
@@ -204,48 +299,942 @@ InheritedAttribute UndwarfTraversal::evaluateInheritedAttribute(SgNode * n, Inhe
         default: ; // Do nothing
     }
 
+    // A record that is only declared needs declaring once per scope,
+    // whichever of its DIEs comes first.
+    SgClassDeclaration * record = isSgClassDeclaration(newDecl);
+    if(record != NULL && record->isForward() && !shared) {
+        ForwardDeclarations::Record & known = DieTable::current()->forwards.lookup(scope, record->get_name().getString());
+        if(known.forward != NULL) {
+            newDecl = NULL;
+        } else {
+            known.forward = record;
+        }
+    }
+
     if(newDecl != NULL)  {
         SageInterface::fixStatement(newDecl, scope);
-        SageInterface::insertStatementAfterLastDeclaration(newDecl, scope);
+        if(!shared) {
+            DieTable::current()->declarations.append(scope, newDecl);
+        }
     }
 
     return InheritedAttribute(parentScope);
 }
 
+// Attaches the declarations queued during conversion to their scopes.
+struct AppendStatement {
+    void operator()(SgScopeStatement * scope, SgStatement * s) const {
+        scope->append_statement(s);
+    };
+};
+
+// Frees everything that was built for one compilation unit: its DWARF IR
+// and the generated source file. The unit's DieTable goes away on its own.
+static void releaseUnit(SgAsmDwarfCompilationUnit * unit, SgSourceFile * file) {
+    SageInterface::deleteAST(file);
+    SageInterface::deleteAST(unit);
+}
+
+// Turns the generated file into text with the emitter the options ask for.
+static std::string headerText(SgGlobal * global, const std::string & unitName, const UndwarfOptions & options) {
+    if(options.emitter == UndwarfOptions::ROSE_UNPARSER) {
+        return global->unparseToCompleteString() + "\n\n";
+    }
+
+    std::string direct;
+    HeaderEmitter emitter(direct);
+    emitter.emit(global);
+    direct += "\n\n";
+    if(options.emitter == UndwarfOptions::DIRECT) {
+        return direct;
+    }
+
+    std::string rose = global->unparseToCompleteString() + "\n\n";
+    if(direct != rose) {
+        size_t at = 0;
+        while(at < direct.size() && at < rose.size() && direct[at] == rose[at]) {
+            ++at;
+        }
+        size_t line = std::count(rose.begin(), rose.begin() + at, '\n') + 1;
+        size_t lineStart = rose.rfind('\n', at == 0 ? 0 : at - 1);
+        lineStart = (lineStart == std::string::npos || at == 0) ? 0 : lineStart + 1;
+        std::cerr << "WARNING: Direct emitter output for " << unitName << " differs from ROSE's at line " << line << ":" << std::endl
+            << "  rose:   " << rose.substr(lineStart, rose.find('\n', lineStart) - lineStart) << std::endl
+            << "  direct: " << direct.substr(lineStart, direct.find('\n', lineStart) - lineStart) << std::endl;
+    }
+    return rose;
+}
+
+// Adds the text of each declaration in ns, and in the namespaces nested
+// in it, to pieces along with the path of namespaces it is in.
+static void namespacePieces(SgNamespaceDeclarationStatement * ns, const std::string & path, const UndwarfOptions & options,
+        std::vector<std::pair<std::string, std::string> > & pieces) {
+    SgNamespaceDefinitionStatement * def = ns->get_definition();
+    if(def == NULL) {
+        return;
+    }
+    BOOST_FOREACH(SgDeclarationStatement * decl, def->get_declarations()) {
+        if(SgNamespaceDeclarationStatement * inner = isSgNamespaceDeclarationStatement(decl)) {
+            namespacePieces(inner, path + "::" + inner->get_name().getString(), options, pieces);
+            continue;
+        }
+        std::string text;
+        if(options.emitter == UndwarfOptions::DIRECT) {
+            HeaderEmitter emitter(text);
+            emitter.emit(decl);
+        } else {
+            text = decl->unparseToString() + "\n";
+        }
+        pieces.push_back(std::make_pair(path, text));
+    }
+}
+
+// Takes the top-level namespaces out of the generated file and returns
+// their declarations one by one, so each namespace's header can hold
+// every declaration once. The namespaces taken out are added to removed.
+static std::vector<std::pair<std::string, std::string> > splitNamespaces(SgGlobal * global, const UndwarfOptions & options,
+        std::vector<SgNamespaceDeclarationStatement *> & removed) {
+    std::vector<std::pair<std::string, std::string> > pieces;
+    SgDeclarationStatementPtrList decls = global->get_declarations();
+    BOOST_FOREACH(SgDeclarationStatement * decl, decls) {
+        SgNamespaceDeclarationStatement * ns = isSgNamespaceDeclarationStatement(decl);
+        if(ns == NULL) {
+            continue;
+        }
+        namespacePieces(ns, ns->get_name().getString(), options, pieces);
+        SageInterface::removeStatement(ns);
+        removed.push_back(ns);
+    }
+    return pieces;
+}
+
+// Which parts of a compilation unit to convert. Offsets are those of
+// constructs within the unit.
+struct UnitSelection {
+    // Only what the declarations of these functions need
+    const SymbolSet * roots;
+    // Only these constructs and what they need
+    std::vector<uint64_t> wanted;
+    // Parts of types an earlier unit already printed
+    std::vector<uint64_t> shared;
+    // Left out along with everything below them
+    std::vector<uint64_t> filtered;
+
+    explicit UnitSelection(const SymbolSet * r = NULL) : roots(r) {};
+};
+
+// Counts the unit's DIEs by tag, named after their construct class.
+static void countDies(DieTable & table, UnitStats & stats) {
+    for(size_t id = 0; id < table.size(); ++id) {
+        std::string tag = table[id].construct->class_name();
+        if(boost::starts_with(tag, "SgAsmDwarf")) {
+            tag.erase(0, strlen("SgAsmDwarf"));
+        }
+        ++stats.dies[tag];
+    }
+}
+
+// The stats a unit's conversion adds to, set up for tracing if that was
+// asked for; NULL if nothing is measured.
+static UnitStats * unitStats(const UndwarfOptions & options, UnitStats & stats) {
+    if(!options.measured()) {
+        return NULL;
+    }
+    if(!options.traceFile.empty()) {
+        stats.startTrace(options.traceTypes);
+    }
+    return &stats;
+}
+
+// Convert one DWARF compilation unit into a header and return it as an
+// encoded UnitOutput, restricted to what selection asks for.
+// In streaming mode everything the unit owned is freed afterwards.
+// If stats isn't NULL, the time of each phase and what was converted
+// are added to it, and it goes out with the output.
+static std::string generateHeader(SgProject * project, SgAsmDwarfCompilationUnit * unit, const UndwarfOptions & options,
+        const UnitSelection & selection, UnitStats * stats = NULL) {
+    DieTable table;
+    table.stats = stats;
+    PhaseTimer timer(stats, UnitStats::INDEX);
+    indexAndAnnotate(unit, table);
+    BOOST_FOREACH(uint64_t offset, selection.shared) {
+        DieAnnotation * attr = table.find(offset);
+        if(attr != NULL) {
+            attr->shared = true;
+        }
+    }
+    if(selection.roots != NULL || !selection.wanted.empty()) {
+        size_t kept = selection.roots != NULL ? Reachability::prune(table, *selection.roots) :
+            Reachability::prune(table, selection.wanted);
+        if(project->get_verbose() > 0) {
+            std::cerr << "Keeping " << kept << " of " << table.size() << " constructs of " << unit->get_name() << std::endl;
+        }
+    }
+    BOOST_FOREACH(uint64_t offset, selection.filtered) {
+        DieAnnotation * attr = table.find(offset);
+        if(attr != NULL) {
+            attr->pruned = true;
+        }
+    }
+    if(!selection.filtered.empty() && project->get_verbose() > 0) {
+        std::cerr << "Leaving out " << selection.filtered.size() << " filtered declarations of " << unit->get_name() << std::endl;
+    }
+    DieTable::setCurrent(&table);
+
+    SgSourceFile * newFile = newFileInProject(project);
+    SgGlobal * global = newFile->get_globalScope();
+    // Make sure the global scope is marked as a transformation
+    // or it won't unparse correctly.
+    SageInterface::setSourcePositionForTransformation(global);
+    global->set_startOfConstruct(Sg_File_Info::generateDefaultFileInfoForTransformationNode());
+    global->set_endOfConstruct(Sg_File_Info::generateDefaultFileInfoForTransformationNode());
+
+    // Note in the output what the source of the code was.
+    SageInterface::attachComment(global, std::string("BEGIN COMPILATION UNIT ") + unit->get_name());
+
+    // Generate the header
+    timer.next(UnitStats::TRAVERSAL);
+    InheritedAttribute attr(NULL);
+    UndwarfTraversal traversal(global);
+    traversal.traverse(unit, attr);
+    timer.next(UnitStats::ORDER);
+    size_t attached = table.declarations.flush(AppendStatement());
+    size_t dropped = DeclarationOrder::sort(global);
+    if(project->get_verbose() > 0) {
+        std::cerr << "Dropped " << dropped << " forward declarations from " << unit->get_name() << std::endl;
+    }
+    timer.next(UnitStats::VALIDATE);
+    Validation::check(newFile, options.validate, unit->get_name());
+
+    timer.next(UnitStats::OUTPUT);
+    UnitOutput output;
+    output.unitName = unit->get_name();
+    std::vector<SgNamespaceDeclarationStatement *> removed;
+    if(options.splitNamespaces) {
+        output.namespaces = splitNamespaces(global, options, removed);
+    }
+    output.header = headerText(global, unit->get_name(), options);
+    // Only now, since the rest of the file may name types declared in them.
+    BOOST_FOREACH(SgNamespaceDeclarationStatement * ns, removed) {
+        SageInterface::deleteAST(ns);
+    }
+    timer.stop();
+
+    DieTable::setCurrent(NULL);
+    if(stats != NULL) {
+        countDies(table, *stats);
+        stats->declarations += attached - dropped;
+        stats->typesConverted += table.types.misses();
+        output.stats = stats->encode();
+    }
+    if(project->get_verbose() > 0) {
+        std::cerr << "Reused " << table.forwards.reused() << " forward declarations in " << unit->get_name() << std::endl;
+    }
+    DwarfROSE::type_cache_hits += table.types.hits();
+    DwarfROSE::type_cache_misses += table.types.misses();
+    if(options.stream) {
+        releaseUnit(unit, newFile);
+    }
+    return output.encode();
+}
+
+static void reportTypeCache(SgProject * project) {
+    if(project->get_verbose() > 0) {
+        std::cerr << "Type conversion cache: " << DwarfROSE::type_cache_hits << " hits, "
+            << DwarfROSE::type_cache_misses << " misses" << std::endl;
+    }
+}
+
+// Converts the units of one binary read with the native reader.
+class NativeJob : public UnitJob {
+    private:
+        SgProject * project;
+        const UndwarfOptions & options;
+        ElfFile & elf;
+        const DwarfReader & reader;
+        TypeDedup & dedup;
+        const SymbolSet * roots;
+        const UnitFilter * filter;
+        UnitCache * cache;
+        // What besides its DIEs a unit's output depends on
+        std::string cacheContext;
+        // When units run in this process, prepare() reads them ahead on
+        // its own thread and leaves them here for run().
+        bool local;
+        std::map<size_t, DwarfUnit *> prepared;
+        // Cache keys of the units being run, and the cached output of
+        // those that aren't.
+        std::map<size_t, ContentDigest> keys;
+        std::map<size_t, std::string> cached;
+        boost::mutex preparedMutex;
+
+        bool read(size_t index, DwarfUnit & unit) {
+            const DwarfUnitHeader & header = reader.units()[index];
+            if(!reader.readUnit(header, unit)) {
+                std::cerr << "WARNING: Compilation unit at offset " << header.offset << " in " << elf.path() << " was not fully read." << std::endl;
+                return false;
+            }
+            return true;
+        };
+
+    public:
+        NativeJob(SgProject * p, const UndwarfOptions & o, ElfFile & e, const DwarfReader & r, TypeDedup & d,
+                const SymbolSet * s, const UnitFilter * f, UnitCache * c) :
+            project(p), options(o), elf(e), reader(r), dedup(d), roots(s), filter(f), cache(c), local(o.jobs <= 1) {
+            cacheContext = options.fingerprint();
+            if(roots != NULL) {
+                // The same roots in any order give the same output.
+                std::vector<std::string> names(roots->begin(), roots->end());
+                std::sort(names.begin(), names.end());
+                ContentHasher hasher;
+                BOOST_FOREACH(const std::string & name, names) {
+                    hasher.update(name.c_str(), name.size() + 1);
+                }
+                cacheContext += " roots=" + hasher.digest().hex();
+            }
+        };
+
+        virtual ~NativeJob() {
+            std::map<size_t, DwarfUnit *>::iterator it;
+            for(it = prepared.begin(); it != prepared.end(); ++it) {
+                delete it->second;
+            }
+        };
+
+        // A unit's length in .debug_info is a good enough measure of how
+        // many DIEs it has.
+        virtual uint64_t cost(size_t index) {
+            return reader.units()[index].length;
+        };
+
+        // Reads the unit if it will run here. Deduplication depends on
+        // every earlier unit, so it is done here too, in order; the offsets
+        // of the shared constructs go to run(). With a cache the unit is
+        // read to compute its key, and a unit found in the cache isn't
+        // run at all.
+        virtual std::string prepare(size_t index) {
+            if(!local && !options.dedup && cache == NULL) {
+                return std::string();
+            }
+            DwarfUnit * dwarfUnit = new DwarfUnit();
+            read(index, *dwarfUnit);
+            std::vector<uint64_t> shared;
+            if(options.dedup) {
+                dedup.markShared(*dwarfUnit, shared);
+            }
+            std::string sharedBytes(reinterpret_cast<const char *>(shared.empty() ? NULL : &shared[0]),
+                    shared.size() * sizeof(uint64_t));
+
+            if(cache != NULL) {
+                // What the filters leave out depends on the unit's line
+                // table as well as its DIEs.
+                std::string context = cacheContext + sharedBytes;
+                if(filter != NULL) {
+                    std::vector<uint64_t> filtered;
+                    filter->apply(reader, *dwarfUnit, filtered);
+                    context += " filtered=" + std::string(reinterpret_cast<const char *>(filtered.empty() ? NULL : &filtered[0]),
+                            filtered.size() * sizeof(uint64_t));
+                }
+                ContentDigest key = cache->key(*dwarfUnit, context);
+                std::string output;
+                bool hit = cache->lookup(key, reader.units()[index].offset, output);
+                boost::mutex::scoped_lock lock(preparedMutex);
+                if(hit) {
+                    cached[index].swap(output);
+                    delete dwarfUnit;
+                    return std::string();
+                }
+                keys[index] = key;
+            }
+            if(local) {
+                boost::mutex::scoped_lock lock(preparedMutex);
+                prepared[index] = dwarfUnit;
+            } else {
+                delete dwarfUnit;
+            }
+            return sharedBytes;
+        };
+
+        virtual bool reuse(size_t index, std::string & output) {
+            boost::mutex::scoped_lock lock(preparedMutex);
+            std::map<size_t, std::string>::iterator it = cached.find(index);
+            if(it == cached.end()) {
+                return false;
+            }
+            output.swap(it->second);
+            cached.erase(it);
+            return true;
+        };
+
+        virtual void completed(size_t index, const std::string & output) {
+            ContentDigest key;
+            {
+                boost::mutex::scoped_lock lock(preparedMutex);
+                std::map<size_t, ContentDigest>::iterator it = keys.find(index);
+                if(it == keys.end()) {
+                    return;
+                }
+                key = it->second;
+                keys.erase(it);
+            }
+            // Stats describe this run only.
+            UnitOutput unitOutput;
+            if(options.measured() && unitOutput.decode(output) && !unitOutput.stats.empty()) {
+                unitOutput.stats.clear();
+                cache->store(key, reader.units()[index].offset, unitOutput.encode());
+                return;
+            }
+            cache->store(key, reader.units()[index].offset, output);
+        };
+
+        virtual std::string run(size_t index, const std::string & input) {
+            UnitStats stats;
+            UnitStats * measured = unitStats(options, stats);
+            PhaseTimer timer(measured, UnitStats::READ);
+            DwarfUnit * dwarfUnit = NULL;
+            {
+                boost::mutex::scoped_lock lock(preparedMutex);
+                std::map<size_t, DwarfUnit *>::iterator it = prepared.find(index);
+                if(it != prepared.end()) {
+                    dwarfUnit = it->second;
+                    prepared.erase(it);
+                }
+            }
+            if(dwarfUnit == NULL) {
+                dwarfUnit = new DwarfUnit();
+                read(index, *dwarfUnit);
+            }
+            UnitSelection selection(roots);
+            selection.shared.resize(input.size() / sizeof(uint64_t));
+            if(!selection.shared.empty()) {
+                memcpy(&selection.shared[0], input.data(), selection.shared.size() * sizeof(uint64_t));
+            }
+            if(filter != NULL) {
+                filter->apply(reader, *dwarfUnit, selection.filtered);
+            }
+
+            std::string header = UnitOutput().encode();
+            SgAsmDwarfCompilationUnit * unit = DwarfBuilder::buildUnit(*dwarfUnit);
+            delete dwarfUnit;
+            timer.stop();
+            if(unit != NULL) {
+                header = generateHeader(project, unit, options, selection, measured);
+            }
+
+            // This unit's part of .debug_info won't be looked at again.
+            SectionData data = reader.unitData(reader.units()[index]);
+            elf.release(data.data, data.size);
+            return header;
+        };
+
+        virtual void finish() {
+            reportTypeCache(project);
+        };
+};
+
+// Converts the units the ROSE frontend loaded.
+class FrontendJob : public UnitJob {
+    private:
+        SgProject * project;
+        const UndwarfOptions & options;
+        const Rose_STL_Container<SgNode*> & units;
+        const SymbolSet * roots;
+
+    public:
+        FrontendJob(SgProject * p, const UndwarfOptions & o, const Rose_STL_Container<SgNode*> & u, const SymbolSet * r) :
+            project(p), options(o), units(u), roots(r) {};
+
+        virtual uint64_t cost(size_t index) {
+            return countConstructs(isSgAsmDwarfConstruct(units[index]));
+        };
+
+        virtual std::string run(size_t index, const std::string & input) {
+            UnitStats stats;
+            return generateHeader(project, isSgAsmDwarfCompilationUnit(units[index]), options, UnitSelection(roots),
+                    unitStats(options, stats));
+        };
+
+        virtual void finish() {
+            reportTypeCache(project);
+        };
+};
+
+// Adds the functions the output is restricted to: those in the symbol
+// list and those the binary exports, as the options ask. Returns false if
+// the symbol list can't be read.
+static bool addRoots(const UndwarfOptions & options, ElfFile & elf, SymbolSet & roots) {
+    if(!options.symbolFile.empty() && !Reachability::readSymbolList(options.symbolFile, roots)) {
+        return false;
+    }
+    if(options.exported) {
+        std::vector<std::string> exports = elf.exportedSymbols();
+        if(exports.empty()) {
+            std::cerr << "WARNING: " << elf.path() << " exports no functions." << std::endl;
+        }
+        roots.insert(exports.begin(), exports.end());
+    }
+    return true;
+}
+
+// Read the DWARF sections of each input directly, building the ROSE IR
+// for one compilation unit at a time instead of running frontend().
+// In streaming mode each unit is freed as soon as its header is written,
+// so peak memory depends on the largest unit rather than on the binary.
+// With dedup, a type is only written by the first unit that defines it.
+static bool convertInputs(const UndwarfOptions & options, SgProject * project, UnitCache * cache, UnitSink & sink,
+        RunStats * stats) {
+    TypeDedup dedup;
+    UnitFilter filter(options.includeNames, options.excludeNames, options.includeFiles, options.excludeFiles);
+    BOOST_FOREACH(const std::string & path, options.inputs) {
+        uint64_t opened = RunStats::microseconds();
+        ElfFile elf;
+        if(!elf.open(path)) {
+            return false;
+        }
+        DwarfReader reader(elf);
+        if(!reader.valid()) {
+            std::cerr << "WARNING: " << path << " has no DWARF debug information." << std::endl;
+            continue;
+        }
+
+        boost::scoped_ptr<SymbolSet> roots;
+        if(options.exported || !options.symbolFile.empty()) {
+            roots.reset(new SymbolSet());
+            if(!addRoots(options, elf, *roots)) {
+                return false;
+            }
+        }
+        if(stats != NULL) {
+            stats->addFrontend(opened, RunStats::microseconds());
+        }
+
+        NativeJob job(project, options, elf, reader, dedup, roots.get(), filter.empty() ? NULL : &filter, cache);
+        if(!WorkerPool::run(job, reader.units().size(), options.jobs, sink, options.verbose > 0)) {
+            return false;
+        }
+    }
+
+    if(options.dedup && options.verbose > 0) {
+        std::cerr << "Type deduplication: " << dedup.distinctTypes() << " distinct types, "
+            << dedup.sharedDefinitions() << " repeated definitions not written again" << std::endl;
+    }
+    if(cache != NULL && options.verbose > 0) {
+        cache->report(std::cerr);
+    }
+    return true;
+}
+
+// Prints or writes the run's stats and trace if they were asked for.
+// False if a file couldn't be written.
+static bool reportStats(const UndwarfOptions & options, const RunStats & stats) {
+    bool ok = true;
+    if(!options.traceFile.empty()) {
+        ok = stats.writeTrace(options.traceFile);
+    }
+    if(!options.stats) {
+        return ok;
+    }
+    if(options.statsJson.empty()) {
+        stats.report(std::cerr);
+        return ok;
+    }
+    return stats.writeJson(options.statsJson) && ok;
+}
+
+static int runNative(const UndwarfOptions & options, UnitSink & sink, RunStats * stats) {
+    if(options.inputs.empty()) {
+        std::cerr << "ERROR: No input file given." << std::endl;
+        return 1;
+    }
+
+    SgProject * project = new SgProject();
+    project->set_verbose(options.verbose);
+    boost::scoped_ptr<UnitCache> cache;
+    if(!options.cacheDir.empty()) {
+        cache.reset(new UnitCache(options.cacheDir));
+        if(!cache->valid()) {
+            return 1;
+        }
+    }
+    return convertInputs(options, project, cache.get(), sink, stats) ? 0 : 1;
+}
+
+// Finds or builds the name index of a binary. With a cache directory the
+// index is kept there, so only the first query of a binary reads all of
+// its units.
+static void openIndex(const UndwarfOptions & options, ElfFile & elf, const DwarfReader & reader, NameIndex & index) {
+    std::string path;
+    std::vector<uint64_t> identity = NameIndex::identify(elf.path());
+    if(!options.cacheDir.empty() && !identity.empty()) {
+        char resolved[PATH_MAX];
+        std::string binary = realpath(elf.path().c_str(), resolved) != NULL ? resolved : elf.path();
+        ContentHasher hasher;
+        hasher.update(binary);
+        path = options.cacheDir + "/index-" + hasher.digest().hex();
+        if(index.load(path, identity)) {
+            if(options.verbose > 0) {
+                std::cerr << "Using name index " << path << std::endl;
+            }
+            return;
+        }
+    }
+    if(options.verbose > 0) {
+        std::cerr << "Indexing the names in " << elf.path() << std::endl;
+    }
+    index.build(elf, reader);
+    if(!path.empty() && makeDirectories(options.cacheDir)) {
+        index.save(path, identity);
+    }
+}
+
+// Converts the constructs at offsets in one unit, and what they need, into
+// an encoded UnitOutput.
+static std::string convertSelected(SgProject * project, const UndwarfOptions & options, const DwarfReader & reader,
+        uint32_t index, const std::vector<uint64_t> & offsets) {
+    const DwarfUnitHeader & header = reader.units()[index];
+    DwarfUnit dwarfUnit;
+    if(!reader.readUnit(header, dwarfUnit)) {
+        std::cerr << "WARNING: Compilation unit at offset " << header.offset << " was not fully read." << std::endl;
+    }
+    SgAsmDwarfCompilationUnit * unit = DwarfBuilder::buildUnit(dwarfUnit);
+    if(unit == NULL) {
+        return UnitOutput().encode();
+    }
+    UnitSelection selection;
+    selection.wanted = offsets;
+    return generateHeader(project, unit, options, selection);
+}
+
+// Prints the declarations of the types and functions named in the
+// queries and what they need. Each name is looked up in the name index;
+// only the units holding the chosen declarations (a definition where
+// there is one) are read and converted, and only as far as needed.
+static int queryNative(const UndwarfOptions & options, UnitSink & sink) {
+    if(options.inputs.empty()) {
+        std::cerr << "ERROR: No input file given." << std::endl;
+        return 1;
+    }
+    SgProject * project = new SgProject();
+    project->set_verbose(options.verbose);
+
+    std::set<std::string> found;
+    size_t written = 0;
+    BOOST_FOREACH(const std::string & path, options.inputs) {
+        ElfFile elf;
+        if(!elf.open(path)) {
+            return 1;
+        }
+        DwarfReader reader(elf);
+        if(!reader.valid()) {
+            std::cerr << "WARNING: " << path << " has no DWARF debug information." << std::endl;
+            continue;
+        }
+        NameIndex index;
+        openIndex(options, elf, reader, index);
+
+        // The constructs to keep, by unit
+        std::map<uint32_t, std::vector<uint64_t> > wanted;
+        BOOST_FOREACH(const std::string & name, options.queries) {
+            if(found.count(name) > 0) {
+                continue;
+            }
+            std::vector<NameIndex::Location> locations = index.find(name);
+            if(!locations.empty()) {
+                wanted[locations[0].unit].push_back(locations[0].offset);
+                found.insert(name);
+            }
+        }
+
+        std::map<uint32_t, std::vector<uint64_t> >::const_iterator it;
+        for(it = wanted.begin(); it != wanted.end(); ++it) {
+            sink.write(written++, convertSelected(project, options, reader, it->first, it->second));
+        }
+    }
+
+    bool ok = true;
+    BOOST_FOREACH(const std::string & name, options.queries) {
+        if(found.count(name) == 0) {
+            std::cerr << "ERROR: No type or function named " << name << " found." << std::endl;
+            ok = false;
+        }
+    }
+    return ok ? 0 : 1;
+}
+
+// A binary the server answers about, loaded and indexed once.
+struct ServedBinary {
+    ElfFile elf;
+    boost::scoped_ptr<DwarfReader> reader;
+    NameIndex index;
+};
+
+// Answers the server's requests:
+//     declare NAME...   the declarations of the named types and functions
+//                       and what they need, as -undwarf:query prints them
+//     layout NAME       the size of the named structure, class or union
+//                       and the offset, size and type of its members
+// Names are looked up in each binary's index in turn. Layouts come
+// straight from the DIE records and are computed side by side; the ROSE
+// IR isn't safe to build from several threads, so declarations are
+// converted one request at a time. Every answer is remembered, so asking
+// again is only a lookup.
+class ServeHandler : public QueryHandler {
+    private:
+        SgProject * project;
+        const UndwarfOptions & options;
+        std::vector<ServedBinary *> binaries;
+        boost::mutex convertMutex;
+        boost::mutex answersMutex;
+        std::map<std::string, std::string> answers;
+
+        ServedBinary * find(const std::string & name, std::vector<NameIndex::Location> & locations) {
+            BOOST_FOREACH(ServedBinary * binary, binaries) {
+                locations = binary->index.find(name);
+                if(!locations.empty()) {
+                    return binary;
+                }
+            }
+            return NULL;
+        };
+
+        bool declare(const std::vector<std::string> & names, std::string & answer) {
+            // The constructs to keep, by binary and unit
+            std::map<std::pair<ServedBinary *, uint32_t>, std::vector<uint64_t> > wanted;
+            BOOST_FOREACH(const std::string & name, names) {
+                std::vector<NameIndex::Location> locations;
+                ServedBinary * binary = find(name, locations);
+                if(binary == NULL) {
+                    answer = "No type or function named " + name + " found.";
+                    return false;
+                }
+                wanted[std::make_pair(binary, locations[0].unit)].push_back(locations[0].offset);
+            }
+
+            boost::mutex::scoped_lock lock(convertMutex);
+            std::map<std::pair<ServedBinary *, uint32_t>, std::vector<uint64_t> >::const_iterator it;
+            for(it = wanted.begin(); it != wanted.end(); ++it) {
+                UnitOutput output;
+                output.decode(convertSelected(project, options, *it->first.first->reader, it->first.second, it->second));
+                answer += output.header + namespaceText(output.namespaces);
+            }
+            return true;
+        };
+
+        bool layout(const std::string & name, std::string & answer) {
+            std::vector<NameIndex::Location> locations;
+            ServedBinary * binary = find(name, locations);
+            if(binary == NULL) {
+                answer = "No type named " + name + " found.";
+                return false;
+            }
+            // Definitions come first; the first that is a class is it.
+            BOOST_FOREACH(const NameIndex::Location & location, locations) {
+                DwarfUnit unit;
+                binary->reader->readUnit(binary->reader->units()[location.unit], unit);
+                if(TypeLayout::describe(unit, unit.indexOf(location.offset), name, answer)) {
+                    return true;
+                }
+            }
+            answer = name + " is not a structure, class or union.";
+            return false;
+        };
+
+    public:
+        ServeHandler(SgProject * p, const UndwarfOptions & o) : project(p), options(o) {};
+
+        virtual ~ServeHandler() {
+            BOOST_FOREACH(ServedBinary * binary, binaries) {
+                delete binary;
+            }
+        };
+
+        bool load(const std::string & path) {
+            ServedBinary * binary = new ServedBinary();
+            binaries.push_back(binary);
+            if(!binary->elf.open(path)) {
+                return false;
+            }
+            binary->reader.reset(new DwarfReader(binary->elf));
+            if(!binary->reader->valid()) {
+                std::cerr << "WARNING: " << path << " has no DWARF debug information." << std::endl;
+            }
+            openIndex(options, binary->elf, *binary->reader, binary->index);
+            return true;
+        };
+
+        virtual bool answer(const std::string & command, const std::vector<std::string> & arguments, std::string & answer) {
+            std::string key = command;
+            BOOST_FOREACH(const std::string & argument, arguments) {
+                key += " " + argument;
+            }
+            {
+                boost::mutex::scoped_lock lock(answersMutex);
+                std::map<std::string, std::string>::const_iterator it = answers.find(key);
+                if(it != answers.end()) {
+                    answer = it->second;
+                    return true;
+                }
+            }
+
+            bool ok = false;
+            if(command == "declare" && !arguments.empty()) {
+                ok = declare(arguments, answer);
+            } else if(command == "layout" && arguments.size() == 1) {
+                ok = layout(arguments[0], answer);
+            } else {
+                answer = "Unknown request " + key + "; expected declare NAME... or layout NAME.";
+            }
+            if(ok) {
+                boost::mutex::scoped_lock lock(answersMutex);
+                answers[key] = answer;
+            }
+            return ok;
+        };
+};
+
+// Loads and indexes the inputs, then answers requests on the socket
+// until killed.
+static int serveNative(const UndwarfOptions & options) {
+    if(options.inputs.empty()) {
+        std::cerr << "ERROR: No input file given." << std::endl;
+        return 1;
+    }
+    SgProject * project = new SgProject();
+    project->set_verbose(options.verbose);
+    ServeHandler handler(project, options);
+    BOOST_FOREACH(const std::string & path, options.inputs) {
+        if(!handler.load(path)) {
+            return 1;
+        }
+    }
+    return QueryServer::serve(options.serveSocket, handler, options.verbose > 0) ? 0 : 1;
+}
+
+// Where the headers go: standard output, or one file per unit (and
+// namespace) under the output directory.
+static UnitSink * createSink(const UndwarfOptions & options) {
+    if(options.outputDir.empty()) {
+        return new StreamSink(std::cout);
+    }
+    DirectorySink * sink = new DirectorySink(options.outputDir, OUTPUT_WRITERS);
+    if(!sink->valid()) {
+        delete sink;
+        return NULL;
+    }
+    return sink;
+}
+
+// How long the inputs must be left alone after a change before they are
+// read, in milliseconds.
+static const int WATCH_SETTLE_TIME = 100;
+
+// Converts the inputs, then again every time one of them changes. The
+// process stays up with the output of every unit in memory, so after a
+// relink only the units whose DIEs changed are converted again; the rest
+// are read, hashed and written out from memory.
+static int watchNative(const UndwarfOptions & options) {
+    if(options.inputs.empty()) {
+        std::cerr << "ERROR: No input file given." << std::endl;
+        return 1;
+    }
+    FileWatcher watcher(options.inputs);
+    UnitCache cache(options.cacheDir, true);
+    if(!watcher.valid() || !cache.valid()) {
+        return 1;
+    }
+    SgProject * project = new SgProject();
+    project->set_verbose(options.verbose);
+
+    while(true) {
+        struct timeval start;
+        gettimeofday(&start, NULL);
+        // A fresh sink for every run, so output files are rewritten and
+        // named as in a single run.
+        boost::scoped_ptr<UnitSink> sink(createSink(options));
+        if(!sink) {
+            return 1;
+        }
+        RunStats runStats;
+        StatsSink statsSink(*sink, runStats);
+        UnitSink & out = options.measured() ? static_cast<UnitSink &>(statsSink) : *sink;
+        bool ok = convertInputs(options, project, &cache, out, options.measured() ? &runStats : NULL);
+        ok = out.finish() && ok;
+        cache.endRun();
+        reportStats(options, runStats);
+
+        struct timeval end;
+        gettimeofday(&end, NULL);
+        std::cerr << (ok ? "Headers regenerated" : "WARNING: Regenerating headers failed") << " in "
+            << std::fixed << std::setprecision(2) << (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1e6
+            << " s; waiting for changes." << std::endl;
+
+        if(!watcher.wait(WATCH_SETTLE_TIME)) {
+            return 1;
+        }
+    }
+}
+
 int main ( int argc, char* argv[] ) {
-	// Parses the input files and generates the AST
-	SgProject* project = frontend(argc,argv);
-	ROSE_ASSERT (project != NULL);
+    std::vector<std::string> args = CommandlineProcessing::generateArgListFromArgcArgv(argc, argv);
+    UndwarfOptions options;
+    options.parse(args);
 
-    // Make sure we have a valid AST 
-    AstTests::runAllTests(project);
+    if(!options.serveSocket.empty()) {
+        return serveNative(options);
+    }
 
-    Rose_STL_Container<SgNode*> units = NodeQuery::querySubTree(project, V_SgAsmDwarfCompilationUnit);
-    BOOST_FOREACH(SgNode * n, units) {
-        SgAsmDwarfCompilationUnit * unit = isSgAsmDwarfCompilationUnit(n);
-        offsetMapType & offsets = constructOffsetMap(unit);
-        annotateDwarfConstructs(unit, offsets);
+    if(options.watch) {
+        return watchNative(options);
+    }
 
-        SgSourceFile * newFile = newFileInProject(project);
-        SgGlobal * global = newFile->get_globalScope();
-        // Make sure the global scope is marked as a transformation
-        // or it won't unparse correctly.
-        SageInterface::setSourcePositionForTransformation(global);
-        global->set_startOfConstruct(Sg_File_Info::generateDefaultFileInfoForTransformationNode());
-        global->set_endOfConstruct(Sg_File_Info::generateDefaultFileInfoForTransformationNode());
+    boost::scoped_ptr<UnitSink> sink(createSink(options));
+    if(!sink) {
+        return 1;
+    }
 
-        // Note in the output what the source of the code was.
-        SageInterface::attachComment(global, std::string("BEGIN COMPILATION UNIT ") + unit->get_name());
+    if(!options.queries.empty()) {
+        int status = queryNative(options, *sink);
+        return sink->finish() ? status : 1;
+    }
 
-        // Generate the header
-        InheritedAttribute attr(NULL);
-        UndwarfTraversal traversal(global);
-        traversal.traverse(unit, attr);
+    RunStats runStats;
+    StatsSink statsSink(*sink, runStats);
+    UnitSink & out = options.measured() ? static_cast<UnitSink &>(statsSink) : *sink;
 
+    if(options.native) {
+        int status = runNative(options, out, options.measured() ? &runStats : NULL);
+        bool written = out.finish();
+        return reportStats(options, runStats) && written ? status : 1;
+    }
 
-        // Print the generated header.
-        std::cout << global->unparseToCompleteString() << std::endl << std::endl;
+	// Parses the input files and generates the AST
+    uint64_t start = RunStats::microseconds();
+	SgProject* project = frontend(args);
+	ROSE_ASSERT (project != NULL);
+    runStats.addFrontend(start, RunStats::microseconds());
+
+    // Checking the whole input AST costs as much as converting it, so it
+    // is only done when full validation was asked for.
+    if(options.validate == UndwarfOptions::VALIDATE_FULL) {
+        start = RunStats::microseconds();
+        AstTests::runAllTests(project);
+        runStats.addTests(start, RunStats::microseconds());
+    }
+
+    Rose_STL_Container<SgNode*> units = NodeQuery::querySubTree(project, V_SgAsmDwarfCompilationUnit);
+    boost::scoped_ptr<SymbolSet> roots;
+    if(options.exported || !options.symbolFile.empty()) {
+        roots.reset(new SymbolSet());
+        for(int i = 0; i < project->numberOfFiles(); ++i) {
+            ElfFile elf;
+            if(!elf.open(project->get_file(i).getFileName()) || !addRoots(options, elf, *roots)) {
+                return 1;
+            }
+        }
     }
 
-    return 0;
-}                                  
+    FrontendJob job(project, options, units, roots.get());
+    bool ok = WorkerPool::run(job, units.size(), options.jobs, out, project->get_verbose() > 0);
+    ok = out.finish() && ok;
+    return reportStats(options, runStats) && ok ? 0 : 1;
+}
@@ -0,0 +1,95 @@
+// Sends one request to an undwarf server (undwarf -undwarf:serve SOCKET)
+// and prints the answer:
+//     undwarf-client SOCKET declare acme::net::Socket
+//     undwarf-client SOCKET layout acme::net::Socket
+// Exits with 1 if the server couldn't answer.
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+static bool sendAll(int fd, const std::string & data) {
+    size_t sent = 0;
+    while(sent < data.size()) {
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if(n < 0 && errno == EINTR) {
+            continue;
+        }
+        if(n <= 0) {
+            return false;
+        }
+        sent += n;
+    }
+    return true;
+}
+
+int main(int argc, char * argv[]) {
+    if(argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " SOCKET COMMAND [ARGUMENT...]" << std::endl;
+        return 2;
+    }
+
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if(strlen(argv[1]) >= sizeof(address.sun_path)) {
+        std::cerr << "ERROR: Socket path " << argv[1] << " is too long." << std::endl;
+        return 2;
+    }
+    strcpy(address.sun_path, argv[1]);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd < 0 || connect(fd, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) != 0) {
+        std::cerr << "ERROR: Could not connect to " << argv[1] << ": " << strerror(errno) << std::endl;
+        return 2;
+    }
+
+    std::string request = argv[2];
+    for(int i = 3; i < argc; ++i) {
+        request += std::string(" ") + argv[i];
+    }
+    if(!sendAll(fd, request + "\n")) {
+        std::cerr << "ERROR: Could not send the request: " << strerror(errno) << std::endl;
+        return 2;
+    }
+
+    // The status line, then for OK the announced number of bytes.
+    std::string response;
+    size_t expected = std::string::npos;
+    char buffer[1 << 16];
+    while(true) {
+        size_t newline = response.find('\n');
+        if(expected == std::string::npos && newline != std::string::npos) {
+            std::string status = response.substr(0, newline);
+            if(status.compare(0, 6, "ERROR ") == 0) {
+                std::cerr << "ERROR: " << status.substr(6) << std::endl;
+                return 1;
+            }
+            if(status.compare(0, 3, "OK ") != 0) {
+                std::cerr << "ERROR: Unexpected response " << status << std::endl;
+                return 2;
+            }
+            expected = strtoull(status.c_str() + 3, NULL, 10);
+            response.erase(0, newline + 1);
+        }
+        if(expected != std::string::npos && response.size() >= expected) {
+            break;
+        }
+        ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+        if(n < 0 && errno == EINTR) {
+            continue;
+        }
+        if(n <= 0) {
+            std::cerr << "ERROR: The server closed the connection early." << std::endl;
+            return 2;
+        }
+        response.append(buffer, n);
+    }
+    close(fd);
+    std::cout << response.substr(0, expected);
+    return 0;
+}
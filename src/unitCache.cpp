@@ -0,0 +1,307 @@
+#include "unitCache.h"
+#include "dwarfReader.h"
+#include "outputSink.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <fcntl.h>
+#include <elf.h>
+#include <link.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <boost/lexical_cast.hpp>
+
+// Bumped whenever the entry layout changes.
+static const uint64_t ENTRY_MAGIC = 0x31656863776475ULL;   // "udwche1"
+
+static uint64_t microseconds() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return static_cast<uint64_t>(tv.tv_sec) * 1000000 + tv.tv_usec;
+}
+
+// Adds the GNU build-id notes of a loaded object, as mapped in memory.
+static void digestBuildId(struct dl_phdr_info * info, ContentHasher & hasher) {
+    for(int i = 0; i < info->dlpi_phnum; ++i) {
+        const ElfW(Phdr) & ph = info->dlpi_phdr[i];
+        if(ph.p_type != PT_NOTE) {
+            continue;
+        }
+        size_t align = ph.p_align == 8 ? 8 : 4;
+        const char * p = reinterpret_cast<const char *>(info->dlpi_addr + ph.p_vaddr);
+        const char * end = p + ph.p_memsz;
+        while(p + sizeof(ElfW(Nhdr)) <= end) {
+            const ElfW(Nhdr) * note = reinterpret_cast<const ElfW(Nhdr) *>(p);
+            const char * name = p + sizeof(ElfW(Nhdr));
+            const char * desc = name + ((note->n_namesz + align - 1) & ~(align - 1));
+            if(desc + note->n_descsz > end) {
+                break;
+            }
+            if(note->n_type == NT_GNU_BUILD_ID && note->n_namesz == 4 && memcmp(name, "GNU", 4) == 0) {
+                hasher.update(desc, note->n_descsz);
+            }
+            p = desc + ((note->n_descsz + align - 1) & ~(align - 1));
+        }
+    }
+}
+
+static int digestObject(struct dl_phdr_info * info, size_t, void * data) {
+    ContentHasher & hasher = *static_cast<ContentHasher *>(data);
+    // The program itself is the object without a name.
+    bool program = info->dlpi_name == NULL || info->dlpi_name[0] == '\0';
+    const char * path = program ? "/proc/self/exe" : info->dlpi_name;
+    struct stat st;
+    if(stat(path, &st) == 0) {
+        hasher.update(path, strlen(path) + 1);
+        hasher.update(st.st_size);
+        hasher.update(st.st_mtime);
+        digestBuildId(info, hasher);
+    } else if(program) {
+        std::cerr << "WARNING: Could not find the undwarf binary; cache entries won't notice a rebuilt undwarf." << std::endl;
+    }
+    return 0;
+}
+
+// Any change to undwarf or the ROSE it links can change the output, so
+// the running binary and its shared libraries are part of every key.
+// They are identified by size, modification time and build-id rather
+// than read in full: undwarf is linked statically, and librose alone is
+// hundreds of megabytes.
+static ContentDigest toolDigest() {
+    ContentHasher hasher;
+    dl_iterate_phdr(digestObject, &hasher);
+    return hasher.digest();
+}
+
+// Unnamed types, enums and namespaces are called PREFIX<offset>_ (see
+// DwarfROSE::unnamedName); adds delta to every such offset.
+static std::string rebase(const std::string & text, uint64_t delta) {
+    static const char * prefixes[] = { "_UNNAMED_", "_FUNCTION_POINTER_" };
+    std::string out;
+    out.reserve(text.size() + 64);
+    size_t copied = 0;
+    size_t at = 0;
+    while(at < text.size()) {
+        size_t found = std::string::npos;
+        size_t end = 0;
+        for(size_t p = 0; p < sizeof(prefixes) / sizeof(prefixes[0]); ++p) {
+            size_t f = text.find(prefixes[p], at);
+            if(f < found) {
+                found = f;
+                end = f + strlen(prefixes[p]);
+            }
+        }
+        if(found == std::string::npos) {
+            break;
+        }
+        // _UNNAMED_ is followed by the kind: STRUCT_, ENUM_, ...
+        if(text.compare(found, 9, "_UNNAMED_") == 0) {
+            while(end < text.size() && text[end] >= 'A' && text[end] <= 'Z') {
+                ++end;
+            }
+            if(end < text.size() && text[end] == '_') {
+                ++end;
+            }
+        }
+        size_t digits = end;
+        while(digits < text.size() && text[digits] >= '0' && text[digits] <= '9') {
+            ++digits;
+        }
+        if(digits == end || digits >= text.size() || text[digits] != '_') {
+            at = found + 1;
+            continue;
+        }
+        uint64_t offset = boost::lexical_cast<uint64_t>(text.substr(end, digits - end));
+        out.append(text, copied, end - copied);
+        out += boost::lexical_cast<std::string>(offset + delta);
+        copied = digits;
+        at = digits;
+    }
+    out.append(text, copied, std::string::npos);
+    return out;
+}
+
+static bool rebaseOutput(std::string & encoded, uint64_t delta) {
+    UnitOutput output;
+    if(!output.decode(encoded)) {
+        return false;
+    }
+    output.header = rebase(output.header, delta);
+    for(size_t i = 0; i < output.namespaces.size(); ++i) {
+        output.namespaces[i].first = rebase(output.namespaces[i].first, delta);
+        output.namespaces[i].second = rebase(output.namespaces[i].second, delta);
+    }
+    encoded = output.encode();
+    return true;
+}
+
+UnitCache::UnitCache(const std::string & d, bool r) : directory(d), resident(r), ok(true),
+    hits(0), misses(0), stored(0), rebased(0), hashTime(0), lookupTime(0), hashedBytes(0) {
+    if(!directory.empty() && !makeDirectories(directory)) {
+        std::cerr << "ERROR: Could not create cache directory " << directory << ": " << strerror(errno) << std::endl;
+        ok = false;
+    }
+    tool = toolDigest();
+}
+
+ContentDigest UnitCache::key(const DwarfUnit & unit, const std::string & context) {
+    uint64_t start = microseconds();
+    ContentHasher hasher;
+    hasher.update(ENTRY_MAGIC);
+    hasher.update(tool.high);
+    hasher.update(tool.low);
+    hasher.update(context.size());
+    hasher.update(context);
+    unit.digest(hasher);
+    ContentDigest d = hasher.digest();
+    boost::mutex::scoped_lock lock(mutex);
+    hashTime += microseconds() - start;
+    hashedBytes += unit.header.length;
+    return d;
+}
+
+// Entries are spread over 256 subdirectories to keep each one small.
+std::string UnitCache::entryPath(const ContentDigest & key) const {
+    std::string hex = key.hex();
+    return directory + "/" + hex.substr(0, 2) + "/" + hex.substr(2);
+}
+
+bool UnitCache::readEntry(const ContentDigest & key, uint64_t & base, std::string & output) {
+    bool found = false;
+    int fd = open(entryPath(key).c_str(), O_RDONLY);
+    struct stat st;
+    if(fd >= 0 && fstat(fd, &st) == 0 && static_cast<uint64_t>(st.st_size) >= 3 * sizeof(uint64_t)) {
+        uint64_t header[3];
+        std::string data(st.st_size - sizeof(header), '\0');
+        if(read(fd, header, sizeof(header)) == sizeof(header) && header[0] == ENTRY_MAGIC && header[2] == data.size()
+                && (data.empty() || read(fd, &data[0], data.size()) == static_cast<ssize_t>(data.size()))) {
+            found = true;
+            base = header[1];
+            output.swap(data);
+        }
+    }
+    if(fd >= 0) {
+        close(fd);
+    }
+    return found;
+}
+
+bool UnitCache::lookup(const ContentDigest & key, uint64_t base, std::string & output) {
+    uint64_t start = microseconds();
+    bool found = false;
+    uint64_t entryBase = base;
+    std::string data;
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        std::map<ContentDigest, Entry>::iterator it = entries.find(key);
+        if(it != entries.end()) {
+            it->second.used = true;
+            entryBase = it->second.base;
+            data = it->second.output;
+            found = true;
+        }
+    }
+    if(!found && !directory.empty() && readEntry(key, entryBase, data)) {
+        found = true;
+        if(resident) {
+            boost::mutex::scoped_lock lock(mutex);
+            Entry & entry = entries[key];
+            entry.base = entryBase;
+            entry.output = data;
+            entry.used = true;
+        }
+    }
+    bool moved = found && entryBase != base;
+    if(moved) {
+        found = rebaseOutput(data, base - entryBase);
+    }
+    if(found) {
+        output.swap(data);
+    }
+    boost::mutex::scoped_lock lock(mutex);
+    rebased += moved ? 1 : 0;
+    lookupTime += microseconds() - start;
+    if(found) {
+        ++hits;
+    } else {
+        ++misses;
+    }
+    return found;
+}
+
+void UnitCache::store(const ContentDigest & key, uint64_t base, const std::string & output) {
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        ++stored;
+        if(resident) {
+            Entry & entry = entries[key];
+            entry.base = base;
+            entry.output = output;
+            entry.used = true;
+        }
+    }
+    if(!directory.empty()) {
+        writeEntry(key, base, output);
+    }
+}
+
+void UnitCache::writeEntry(const ContentDigest & key, uint64_t base, const std::string & output) {
+    // Not reset with the counters, so temporary names never repeat.
+    static size_t written = 0;
+    std::string path = entryPath(key);
+    std::string temp;
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        temp = directory + "/.tmp-" + boost::lexical_cast<std::string>(getpid()) + "-" + boost::lexical_cast<std::string>(written++);
+    }
+    mkdir(path.substr(0, path.rfind('/')).c_str(), 0777);
+
+    int fd = open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if(fd < 0) {
+        std::cerr << "WARNING: Could not write cache entry " << temp << ": " << strerror(errno) << std::endl;
+        return;
+    }
+    uint64_t header[3] = { ENTRY_MAGIC, base, output.size() };
+    bool good = write(fd, header, sizeof(header)) == sizeof(header);
+    const char * data = output.data();
+    size_t size = output.size();
+    while(good && size > 0) {
+        ssize_t n = write(fd, data, size);
+        if(n < 0 && errno == EINTR) {
+            continue;
+        }
+        good = n > 0;
+        data += good ? n : 0;
+        size -= good ? n : 0;
+    }
+    good = close(fd) == 0 && good;
+    if(!good || rename(temp.c_str(), path.c_str()) != 0) {
+        std::cerr << "WARNING: Could not write cache entry " << path << ": " << strerror(errno) << std::endl;
+        unlink(temp.c_str());
+    }
+}
+
+void UnitCache::endRun() {
+    boost::mutex::scoped_lock lock(mutex);
+    std::map<ContentDigest, Entry>::iterator it = entries.begin();
+    while(it != entries.end()) {
+        if(it->second.used) {
+            it->second.used = false;
+            ++it;
+        } else {
+            entries.erase(it++);
+        }
+    }
+    hits = misses = stored = rebased = 0;
+    hashTime = lookupTime = hashedBytes = 0;
+}
+
+void UnitCache::report(std::ostream & out) const {
+    boost::mutex::scoped_lock lock(mutex);
+    out << "Unit cache: " << hits << " hits (" << rebased << " moved), " << misses << " misses, " << stored << " stored; hashed "
+        << hashedBytes << " bytes in " << std::fixed << std::setprecision(2) << hashTime / 1e6 << " s, lookups took "
+        << lookupTime / 1e6 << " s" << std::endl;
+}
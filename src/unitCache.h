@@ -0,0 +1,77 @@
+#ifndef __UNITCACHE_H__
+#define __UNITCACHE_H__
+
+#include <stdint.h>
+#include <map>
+#include <ostream>
+#include <string>
+#include <boost/thread/mutex.hpp>
+#include "contentHash.h"
+
+class DwarfUnit;
+
+// Output of earlier runs, kept on disk under a digest of everything that
+// went into it: the undwarf binary itself, the unit's decoded DIEs and
+// whatever else the caller says the output depends on (options, types
+// shared with earlier units). Unchanged units of a rebuilt binary are then
+// only read and hashed, not converted.
+//
+// The names of unnamed types contain their offset in .debug_info, which
+// moves whenever an earlier unit changes size. Entries remember the
+// offset of the unit they were made for, and those names are shifted
+// when an entry is reused for a unit that moved.
+//
+// Entries are written to a temporary file and renamed into place, so
+// concurrent runs sharing a directory never see partial entries.
+//
+// A resident cache also keeps the entries in memory, for a process that
+// converts the same binary over and over; the directory is optional then.
+class UnitCache {
+    public:
+        UnitCache(const std::string & directory, bool resident = false);
+
+        // False if the directory couldn't be created.
+        bool valid() const { return ok; };
+
+        ContentDigest key(const DwarfUnit & unit, const std::string & context);
+
+        // On a hit, sets output (an encoded UnitOutput) as it would have
+        // been generated for a unit at offset base.
+        bool lookup(const ContentDigest & key, uint64_t base, std::string & output);
+        void store(const ContentDigest & key, uint64_t base, const std::string & output);
+
+        void report(std::ostream & out) const;
+        // Forgets resident entries that weren't used since the last call,
+        // so memory follows the current binary, and resets the counters.
+        void endRun();
+
+    private:
+        struct Entry {
+            uint64_t base;
+            std::string output;
+            bool used;
+        };
+
+        std::string directory;
+        bool resident;
+        bool ok;
+        ContentDigest tool;
+        std::map<ContentDigest, Entry> entries;
+
+        size_t hits;
+        size_t misses;
+        size_t stored;
+        size_t rebased;
+        uint64_t hashTime;
+        uint64_t lookupTime;
+        uint64_t hashedBytes;
+        // Lookups and stores may come from different threads; the
+        // entries and the counters are only touched under it.
+        mutable boost::mutex mutex;
+
+        std::string entryPath(const ContentDigest & key) const;
+        bool readEntry(const ContentDigest & key, uint64_t & base, std::string & output);
+        void writeEntry(const ContentDigest & key, uint64_t base, const std::string & output);
+};
+
+#endif
@@ -0,0 +1,222 @@
+#include "unitFilter.h"
+#include "dwarf.h"
+#include <map>
+#include <set>
+#include <boost/foreach.hpp>
+
+const NamePatterns::State NamePatterns::DEAD;
+const NamePatterns::State NamePatterns::ACCEPT;
+const NamePatterns::State NamePatterns::START;
+
+size_t NamePatterns::NameHash::operator()(const char * s) const {
+    // FNV-1a
+    uint64_t h = 14695981039346656037ULL;
+    for(; *s != '\0'; ++s) {
+        h = (h ^ static_cast<unsigned char>(*s)) * 1099511628211ULL;
+    }
+    return static_cast<size_t>(h);
+}
+
+namespace {
+
+typedef std::vector<std::string> Components;
+// Each pattern, with how many of its components the name so far matched
+typedef std::vector<std::pair<uint32_t, uint32_t> > Positions;
+
+Components split(const std::string & pattern) {
+    Components components;
+    size_t start = pattern.compare(0, 2, "::") == 0 ? 2 : 0;
+    while(start <= pattern.size()) {
+        size_t end = pattern.find("::", start);
+        if(end == std::string::npos) {
+            end = pattern.size();
+        }
+        components.push_back(pattern.substr(start, end - start));
+        start = end + 2;
+    }
+    return components;
+}
+
+// Where the patterns at positions go on a name; with name NULL, on a name
+// none of them spells out.
+Positions advance(const std::vector<Components> & parsed, const Positions & positions, const std::string * name) {
+    Positions next;
+    BOOST_FOREACH(const Positions::value_type & p, positions) {
+        const std::string & component = parsed[p.first][p.second];
+        if(component == "*" || (name != NULL && component == *name)) {
+            next.push_back(std::make_pair(p.first, p.second + 1));
+        }
+    }
+    return next;
+}
+
+// The state for a set of positions, adding it if it is new.
+uint32_t intern(const std::vector<Components> & parsed, const Positions & positions,
+        std::map<Positions, uint32_t> & ids, std::vector<Positions> & sets) {
+    if(positions.empty()) {
+        return 0;   // DEAD
+    }
+    BOOST_FOREACH(const Positions::value_type & p, positions) {
+        if(p.second == parsed[p.first].size()) {
+            return 1;   // ACCEPT
+        }
+    }
+    std::map<Positions, uint32_t>::iterator found = ids.find(positions);
+    if(found != ids.end()) {
+        return found->second;
+    }
+    uint32_t id = sets.size();
+    ids[positions] = id;
+    sets.push_back(positions);
+    return id;
+}
+
+}
+
+// Subset construction: each state stands for the set of pattern positions
+// the name so far leaves open. Once any pattern is complete the name and
+// everything inside it matches, so all such sets are the one ACCEPT
+// state.
+NamePatterns::NamePatterns(const std::vector<std::string> & list) : states(START + 1), patterns(0) {
+    std::vector<Components> parsed;
+    BOOST_FOREACH(const std::string & pattern, list) {
+        if(!pattern.empty()) {
+            parsed.push_back(split(pattern));
+        }
+    }
+    patterns = parsed.size();
+    states[ACCEPT].accepting = true;
+    states[ACCEPT].live = true;
+    states[ACCEPT].other = ACCEPT;
+
+    std::vector<Positions> sets(START + 1);
+    for(uint32_t i = 0; i < parsed.size(); ++i) {
+        sets[START].push_back(std::make_pair(i, 0u));
+    }
+    states[START].live = !parsed.empty();
+    std::map<Positions, State> ids;
+    ids[sets[START]] = START;
+
+    for(State s = START; s < sets.size(); ++s) {
+        Positions current = sets[s];
+        std::set<std::string> names;
+        BOOST_FOREACH(const Positions::value_type & p, current) {
+            if(parsed[p.first][p.second] != "*") {
+                names.insert(parsed[p.first][p.second]);
+            }
+        }
+
+        Transitions named;
+        BOOST_FOREACH(const std::string & name, names) {
+            named[name] = intern(parsed, advance(parsed, current, &name), ids, sets);
+        }
+        State other = intern(parsed, advance(parsed, current, NULL), ids, sets);
+        states.resize(sets.size());
+        if(s > START) {
+            states[s].live = true;
+        }
+        states[s].named.swap(named);
+        states[s].other = other;
+    }
+}
+
+NamePatterns::State NamePatterns::next(State s, const char * component) const {
+    const Node & node = states[s];
+    if(node.named.empty()) {
+        return node.other;
+    }
+    Transitions::const_iterator it = node.named.find(component, NameHash(), NameEqual());
+    return it == node.named.end() ? node.other : it->second;
+}
+
+UnitFilter::UnitFilter(const std::vector<std::string> & includeNames, const std::vector<std::string> & excludeNames,
+        const std::vector<std::string> & inFiles, const std::vector<std::string> & exFiles) :
+    include(includeNames), exclude(excludeNames), includeFiles(inFiles), excludeFiles(exFiles) {}
+
+bool UnitFilter::fileKept(const std::string & path) const {
+    BOOST_FOREACH(const std::string & prefix, excludeFiles) {
+        if(path.compare(0, prefix.size(), prefix) == 0) {
+            return false;
+        }
+    }
+    if(includeFiles.empty()) {
+        return true;
+    }
+    BOOST_FOREACH(const std::string & prefix, includeFiles) {
+        if(path.compare(0, prefix.size(), prefix) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Decides for each child of parent, which is the unit or a namespace,
+// whether it is left out; namespaces that are kept are descended into.
+// Unnamed declarations have no name to match. Those that define a
+// function declared elsewhere are decided afterwards, by where the
+// declaration ended up.
+void UnitFilter::visit(const DwarfUnit & unit, uint32_t parent, NamePatterns::State in, NamePatterns::State out,
+        const std::vector<char> & files, std::vector<char> & left, std::vector<uint32_t> & definitions) const {
+    for(uint32_t i = unit.dies[parent].firstChild; i != DwarfDie::NONE; i = unit.dies[i].nextSibling) {
+        const DwarfDie & die = unit.dies[i];
+        bool isNamespace = die.tag == DW_TAG_namespace;
+        bool leave = false;
+        NamePatterns::State nextIn = in;
+        NamePatterns::State nextOut = out;
+        if(isNamespace || !die.name.empty()) {
+            nextIn = include.next(in, die.name.c_str());
+            nextOut = exclude.next(out, die.name.c_str());
+            leave = exclude.matches(nextOut) ||
+                (!include.empty() && !include.matches(nextIn) && (!isNamespace || !include.live(nextIn)));
+        } else if(die.hasSpecRef) {
+            definitions.push_back(i);
+        }
+        if(!leave && !isNamespace && die.declFile < files.size()) {
+            leave = !files[die.declFile];
+        }
+
+        if(leave) {
+            left[i] = 1;
+        } else if(isNamespace) {
+            visit(unit, i, nextIn, nextOut, files, left, definitions);
+        }
+    }
+}
+
+void UnitFilter::apply(const DwarfReader & reader, const DwarfUnit & unit, std::vector<uint64_t> & filtered) const {
+    if(empty() || unit.dies.empty()) {
+        return;
+    }
+    // The unit's file table is small; deciding each file up front leaves
+    // one lookup per declaration. Declarations without a file, such as
+    // base and pointer types, aren't filtered by file.
+    std::vector<char> files;
+    if(!includeFiles.empty() || !excludeFiles.empty()) {
+        std::vector<std::string> names;
+        reader.fileNames(unit, names);
+        files.resize(names.size());
+        for(size_t i = 0; i < names.size(); ++i) {
+            files[i] = names[i].empty() || fileKept(names[i]);
+        }
+    }
+
+    std::vector<char> left(unit.dies.size());
+    std::vector<uint32_t> definitions;
+    visit(unit, 0, include.start(), exclude.start(), files, left, definitions);
+    BOOST_FOREACH(uint32_t i, definitions) {
+        if(left[i]) {
+            continue;
+        }
+        for(uint32_t d = unit.indexOf(unit.dies[i].specRef); d != DwarfDie::NONE; d = unit.dies[d].parent) {
+            if(left[d]) {
+                left[i] = 1;
+                break;
+            }
+        }
+    }
+    for(size_t i = 0; i < left.size(); ++i) {
+        if(left[i]) {
+            filtered.push_back(unit.dies[i].offset);
+        }
+    }
+}
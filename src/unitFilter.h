@@ -0,0 +1,94 @@
+#ifndef __UNITFILTER_H__
+#define __UNITFILTER_H__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <boost/unordered_map.hpp>
+#include "dwarfReader.h"
+
+// A set of qualified name patterns such as acme::net::* compiled into a
+// deterministic automaton over the components of a name. Each component
+// of a pattern is either a name or *, which stands for any one name; a
+// name matching a pattern also matches everything declared inside it.
+// Names are fed to the automaton one component at a time, outermost
+// first, so a walk down the DIE tree only ever takes one transition per
+// DIE.
+class NamePatterns {
+    public:
+        typedef uint32_t State;
+
+        explicit NamePatterns(const std::vector<std::string> & patterns);
+
+        bool empty() const { return patterns == 0; };
+        size_t size() const { return patterns; };
+
+        // The state for the global scope.
+        State start() const { return START; };
+        // The state after entering the scope or declaration component.
+        State next(State s, const char * component) const;
+        // True if the name so far matched a pattern.
+        bool matches(State s) const { return states[s].accepting; };
+        // True if a name inside the one so far may still match.
+        bool live(State s) const { return states[s].live; };
+
+    private:
+        struct NameHash {
+            size_t operator()(const std::string & s) const { return operator()(s.c_str()); };
+            size_t operator()(const char * s) const;
+        };
+        struct NameEqual {
+            bool operator()(const std::string & a, const std::string & b) const { return a == b; };
+            bool operator()(const char * a, const std::string & b) const { return b == a; };
+        };
+        typedef boost::unordered_map<std::string, State, NameHash, NameEqual> Transitions;
+
+        struct Node {
+            bool accepting;
+            bool live;
+            Transitions named;
+            // Where any name not in named leads
+            State other;
+
+            Node() : accepting(false), live(false), other(DEAD) {};
+        };
+
+        static const State DEAD = 0;
+        static const State ACCEPT = 1;
+        static const State START = 2;
+
+        std::vector<Node> states;
+        size_t patterns;
+};
+
+// Leaves parts of a compilation unit out of the output: declarations
+// whose qualified names don't match any include pattern or match an
+// exclude pattern, and declarations made in files whose paths don't
+// start with any included prefix or start with an excluded one. Name
+// patterns are matched on the way down through namespaces, so a
+// namespace no pattern can match inside is left out as a whole; file
+// filters apply to the declarations in namespaces that name a file, not
+// to namespaces, which usually span many files.
+class UnitFilter {
+    public:
+        UnitFilter(const std::vector<std::string> & includeNames, const std::vector<std::string> & excludeNames,
+                const std::vector<std::string> & includeFiles, const std::vector<std::string> & excludeFiles);
+
+        bool empty() const { return include.empty() && exclude.empty() && includeFiles.empty() && excludeFiles.empty(); };
+
+        // Appends to filtered the offsets of the DIEs that are left out,
+        // together with everything below them.
+        void apply(const DwarfReader & reader, const DwarfUnit & unit, std::vector<uint64_t> & filtered) const;
+
+    private:
+        NamePatterns include;
+        NamePatterns exclude;
+        std::vector<std::string> includeFiles;
+        std::vector<std::string> excludeFiles;
+
+        bool fileKept(const std::string & path) const;
+        void visit(const DwarfUnit & unit, uint32_t parent, NamePatterns::State in, NamePatterns::State out,
+                const std::vector<char> & files, std::vector<char> & left, std::vector<uint32_t> & definitions) const;
+};
+
+#endif
@@ -0,0 +1,65 @@
+#include "validation.h"
+#include <iostream>
+
+// Only the first few problems of a unit are described; one broken
+// conversion usually repeats itself many times.
+static const size_t MAX_REPORTED = 10;
+
+namespace {
+
+// Walks the generated tree with the traversal parent as the inherited
+// attribute, so each node's parent pointer can be compared against where
+// the node actually hangs.
+class StructureCheck : public AstTopDownProcessing<SgNode *> {
+    public:
+        size_t problems;
+
+        explicit StructureCheck(const std::string & u) : problems(0), unitName(u) {};
+
+    protected:
+        virtual SgNode * evaluateInheritedAttribute(SgNode * n, SgNode * parent) {
+            if(parent != NULL && n->get_parent() != parent) {
+                report(n, "has the wrong parent");
+            }
+            if(isSgLocatedNode(n) != NULL && n->get_startOfConstruct() == NULL) {
+                report(n, "has no file info");
+            }
+            SgDeclarationStatement * decl = isSgDeclarationStatement(n);
+            if(decl != NULL && decl->get_scope() == NULL) {
+                report(n, "has no scope");
+            }
+            return n;
+        };
+
+    private:
+        std::string unitName;
+
+        void report(SgNode * n, const char * problem) {
+            if(++problems <= MAX_REPORTED) {
+                std::cerr << "WARNING: In the output for " << unitName << ": " << n->class_name() << " " << n << " " << problem << std::endl;
+            }
+        };
+};
+
+}
+
+size_t Validation::check(SgSourceFile * file, UndwarfOptions::Validation level, const std::string & unitName) {
+    if(level == UndwarfOptions::VALIDATE_NONE) {
+        return 0;
+    }
+    StructureCheck structure(unitName);
+    structure.traverse(file->get_globalScope(), NULL);
+    if(structure.problems > MAX_REPORTED) {
+        std::cerr << "WARNING: In the output for " << unitName << ": " << structure.problems - MAX_REPORTED << " more problems" << std::endl;
+    }
+
+    if(level == UndwarfOptions::VALIDATE_FULL) {
+        // The tests take a project; give them one holding just this file.
+        static SgProject * scratch = new SgProject();
+        SgFilePtrList & files = scratch->get_fileList_ptr()->get_listOfFiles();
+        files.push_back(file);
+        AstTests::runAllTests(scratch);
+        files.clear();
+    }
+    return structure.problems;
+}
@@ -0,0 +1,19 @@
+#ifndef __VALIDATION_H__
+#define __VALIDATION_H__
+
+#include "rose.h"
+#include "options.h"
+#include <string>
+
+// Checks on the ASTs undwarf generates, at the levels described in
+// UndwarfOptions::Validation.
+namespace Validation {
+    // Checks the file generated for one compilation unit, printing a
+    // warning for each problem the structural checks find; the full
+    // tests abort on failure as they always do. Returns the number of
+    // problems found. Files are checked on their own, so units converted
+    // in different workers are checked side by side.
+    size_t check(SgSourceFile * file, UndwarfOptions::Validation level, const std::string & unitName);
+}
+
+#endif
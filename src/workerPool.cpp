@@ -0,0 +1,409 @@
+#include "workerPool.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <boost/thread/thread.hpp>
+#include "boundedQueue.h"
+
+// Units and results travel over pipes as frames: the unit number, the
+// time the worker spent on it in microseconds (for results), the length
+// of the data and the data itself.
+static const uint64_t NO_MORE_UNITS = ~static_cast<uint64_t>(0);
+
+struct Worker {
+    pid_t pid;
+    int toWorker;
+    int fromWorker;
+    bool busy;
+    size_t units;
+    uint64_t busyTime;
+};
+
+static uint64_t microseconds() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return static_cast<uint64_t>(tv.tv_sec) * 1000000 + tv.tv_usec;
+}
+
+// Orders units by decreasing cost, keeping unit order among equals.
+class CostlierFirst {
+    public:
+        explicit CostlierFirst(const std::vector<uint64_t> & c) : costs(c) {};
+        bool operator()(size_t a, size_t b) const {
+            return costs[a] != costs[b] ? costs[a] > costs[b] : a < b;
+        };
+    private:
+        const std::vector<uint64_t> & costs;
+};
+
+static bool writeAll(int fd, const char * data, size_t size) {
+    while(size > 0) {
+        ssize_t n = write(fd, data, size);
+        if(n < 0 && errno == EINTR) {
+            continue;
+        }
+        if(n <= 0) {
+            return false;
+        }
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+static bool readAll(int fd, char * data, size_t size) {
+    while(size > 0) {
+        ssize_t n = read(fd, data, size);
+        if(n < 0 && errno == EINTR) {
+            continue;
+        }
+        if(n <= 0) {
+            return false;
+        }
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+static bool writeFrame(int fd, uint64_t unit, uint64_t time, const std::string & data) {
+    uint64_t header[3] = { unit, time, data.size() };
+    return writeAll(fd, reinterpret_cast<const char *>(header), sizeof(header))
+        && writeAll(fd, data.data(), data.size());
+}
+
+static bool readFrame(int fd, uint64_t & unit, uint64_t & time, std::string & data) {
+    uint64_t header[3];
+    if(!readAll(fd, reinterpret_cast<char *>(header), sizeof(header))) {
+        return false;
+    }
+    unit = header[0];
+    time = header[1];
+    data.resize(header[2]);
+    return header[2] == 0 || readAll(fd, &data[0], header[2]);
+}
+
+static void workerLoop(UnitJob & job, int in, int out) {
+    uint64_t unit;
+    uint64_t time;
+    std::string input;
+    while(readFrame(in, unit, time, input) && unit != NO_MORE_UNITS) {
+        uint64_t start = microseconds();
+        std::string result = job.run(unit, input);
+        if(!writeFrame(out, unit, microseconds() - start, result)) {
+            break;
+        }
+    }
+    job.finish();
+}
+
+static bool spawn(UnitJob & job, std::vector<Worker> & workers) {
+    int toWorker[2];
+    int fromWorker[2];
+    if(pipe(toWorker) != 0) {
+        return false;
+    }
+    if(pipe(fromWorker) != 0) {
+        close(toWorker[0]);
+        close(toWorker[1]);
+        return false;
+    }
+
+    pid_t pid = fork();
+    if(pid < 0) {
+        close(toWorker[0]);
+        close(toWorker[1]);
+        close(fromWorker[0]);
+        close(fromWorker[1]);
+        return false;
+    }
+    if(pid == 0) {
+        close(toWorker[1]);
+        close(fromWorker[0]);
+        for(size_t i = 0; i < workers.size(); ++i) {
+            close(workers[i].toWorker);
+            close(workers[i].fromWorker);
+        }
+        workerLoop(job, toWorker[0], fromWorker[1]);
+        // Skip exit handlers and static destructors; they belong to the parent.
+        _exit(0);
+    }
+
+    close(toWorker[0]);
+    close(fromWorker[1]);
+    Worker w;
+    w.pid = pid;
+    w.toWorker = toWorker[1];
+    w.fromWorker = fromWorker[0];
+    w.busy = false;
+    w.units = 0;
+    w.busyTime = 0;
+    workers.push_back(w);
+    return true;
+}
+
+static void reportUtilization(const std::vector<Worker> & workers, uint64_t wallTime) {
+    for(size_t i = 0; i < workers.size(); ++i) {
+        double busy = workers[i].busyTime / 1e6;
+        double wall = wallTime / 1e6;
+        std::cerr << "Worker " << workers[i].pid << ": " << workers[i].units << " units, busy "
+            << std::fixed << std::setprecision(2) << busy << " s of " << wall << " s ("
+            << std::setprecision(1) << (wall > 0 ? 100.0 * busy / wall : 0.0) << "%)" << std::endl;
+    }
+}
+
+// How many units a pipeline stage can get ahead of the next one.
+static const size_t PIPELINE_DEPTH = 4;
+
+struct PipelineItem {
+    size_t unit;
+    std::string * data;
+    // data is already the unit's output
+    bool reused;
+};
+
+struct StageTimes {
+    const char * name;
+    size_t units;
+    uint64_t busyTime;
+};
+
+static void prepareStage(UnitJob * job, size_t count, BoundedQueue<PipelineItem> * queue, StageTimes * times) {
+    for(size_t unit = 0; unit < count; ++unit) {
+        uint64_t start = microseconds();
+        PipelineItem item;
+        item.unit = unit;
+        item.data = new std::string(job->prepare(unit));
+        item.reused = job->reuse(unit, *item.data);
+        times->busyTime += microseconds() - start;
+        times->units++;
+        queue->push(item);
+    }
+    queue->close();
+}
+
+static void writeStage(UnitJob * job, UnitSink * sink, BoundedQueue<PipelineItem> * queue, StageTimes * times) {
+    PipelineItem item;
+    while(queue->pop(item)) {
+        uint64_t start = microseconds();
+        if(!item.reused) {
+            job->completed(item.unit, *item.data);
+        }
+        sink->write(item.unit, *item.data);
+        delete item.data;
+        times->busyTime += microseconds() - start;
+        times->units++;
+    }
+}
+
+static void reportPipeline(const StageTimes * stages, size_t stageCount, const BoundedQueue<PipelineItem> ** queues,
+        uint64_t wallTime) {
+    double wall = wallTime / 1e6;
+    for(size_t i = 0; i < stageCount; ++i) {
+        double busy = stages[i].busyTime / 1e6;
+        std::cerr << "Stage " << stages[i].name << ": " << stages[i].units << " units, busy "
+            << std::fixed << std::setprecision(2) << busy << " s of " << wall << " s ("
+            << std::setprecision(1) << (wall > 0 ? 100.0 * busy / wall : 0.0) << "%, "
+            << (busy > 0 ? stages[i].units / busy : 0.0) << " units/s)" << std::endl;
+        if(i + 1 < stageCount) {
+            std::cerr << "Queue " << stages[i].name << " -> " << stages[i + 1].name << ": max depth "
+                << queues[i]->maxDepth() << ", average " << std::setprecision(2) << queues[i]->averageDepth() << std::endl;
+        }
+    }
+}
+
+// Runs the units in this process. Preparing the next units and writing
+// out the previous ones overlap with running the current one, so the
+// total time approaches that of the slowest stage. Running stays on the
+// calling thread: it is the only stage that touches ROSE, and converting
+// and unparsing can't be split across threads since both use its IR.
+static bool runPipelined(UnitJob & job, size_t count, UnitSink & sink, bool verbose) {
+    BoundedQueue<PipelineItem> toConvert(PIPELINE_DEPTH);
+    BoundedQueue<PipelineItem> toWrite(PIPELINE_DEPTH);
+    StageTimes stages[3] = { { "prepare", 0, 0 }, { "convert", 0, 0 }, { "write", 0, 0 } };
+
+    uint64_t startTime = microseconds();
+    boost::thread preparer(prepareStage, &job, count, &toConvert, &stages[0]);
+    boost::thread writer(writeStage, &job, &sink, &toWrite, &stages[2]);
+
+    PipelineItem item;
+    while(toConvert.pop(item)) {
+        if(item.reused) {
+            toWrite.push(item);
+            continue;
+        }
+        uint64_t start = microseconds();
+        std::string * result = new std::string(job.run(item.unit, *item.data));
+        delete item.data;
+        item.data = result;
+        stages[1].busyTime += microseconds() - start;
+        stages[1].units++;
+        toWrite.push(item);
+    }
+    toWrite.close();
+    preparer.join();
+    writer.join();
+    job.finish();
+
+    if(verbose) {
+        const BoundedQueue<PipelineItem> * queues[2] = { &toConvert, &toWrite };
+        reportPipeline(stages, 3, queues, microseconds() - startTime);
+    }
+    return true;
+}
+
+bool WorkerPool::run(UnitJob & job, size_t count, unsigned workerCount, UnitSink & sink, bool verbose) {
+    if(workerCount <= 1 || count <= 1) {
+        return runPipelined(job, count, sink, verbose);
+    }
+    if(workerCount > count) {
+        workerCount = count;
+    }
+
+    // Anything still buffered would otherwise be written again by each worker.
+    std::cout.flush();
+    std::cerr.flush();
+    fflush(NULL);
+    // A worker that dies must show up as a failed write, not kill us.
+    void (*oldPipeHandler)(int) = signal(SIGPIPE, SIG_IGN);
+
+    // Largest units first. prepare() still has to see units in order, so
+    // units are prepared ahead of the one being handed out as needed and
+    // their inputs kept until then.
+    std::vector<uint64_t> costs(count);
+    std::vector<size_t> order(count);
+    for(size_t unit = 0; unit < count; ++unit) {
+        costs[unit] = job.cost(unit);
+        order[unit] = unit;
+    }
+    std::stable_sort(order.begin(), order.end(), CostlierFirst(costs));
+    std::vector<std::string> inputs(count);
+    std::vector<bool> reused(count, false);
+    size_t prepared = 0;
+
+    uint64_t startTime = microseconds();
+    std::vector<Worker> workers;
+    for(unsigned i = 0; i < workerCount; ++i) {
+        if(!spawn(job, workers)) {
+            std::cerr << "WARNING: Could only start " << workers.size() << " of " << workerCount
+                << " workers: " << strerror(errno) << std::endl;
+            break;
+        }
+    }
+
+    bool ok = !workers.empty();
+    size_t next = 0;
+    size_t written = 0;
+    std::map<size_t, std::string> finished;
+    std::vector<struct pollfd> fds(workers.size());
+
+    while(ok && written < count) {
+        // Hand every idle worker the next unit that still has to be run.
+        for(size_t i = 0; i < workers.size() && next < count; ++i) {
+            if(workers[i].busy) {
+                continue;
+            }
+            size_t unit = count;
+            while(next < count && unit == count) {
+                size_t candidate = order[next++];
+                for(; prepared <= candidate; ++prepared) {
+                    inputs[prepared] = job.prepare(prepared);
+                    if(job.reuse(prepared, inputs[prepared])) {
+                        reused[prepared] = true;
+                        finished[prepared].swap(inputs[prepared]);
+                    }
+                }
+                if(!reused[candidate]) {
+                    unit = candidate;
+                }
+            }
+            if(unit == count) {
+                break;
+            }
+            if(!writeFrame(workers[i].toWorker, unit, 0, inputs[unit])) {
+                std::cerr << "ERROR: Could not send unit " << unit << " to worker " << workers[i].pid << std::endl;
+                ok = false;
+                break;
+            }
+            std::string().swap(inputs[unit]);
+            workers[i].busy = true;
+        }
+        if(!ok) {
+            break;
+        }
+
+        bool waiting = false;
+        for(size_t i = 0; i < workers.size(); ++i) {
+            fds[i].fd = workers[i].busy ? workers[i].fromWorker : -1;
+            fds[i].events = POLLIN;
+            fds[i].revents = 0;
+            waiting = waiting || workers[i].busy;
+        }
+        // With every remaining unit reused there is nothing to wait for.
+        if(waiting && poll(&fds[0], fds.size(), -1) < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            std::cerr << "ERROR: poll failed: " << strerror(errno) << std::endl;
+            ok = false;
+            break;
+        }
+
+        for(size_t i = 0; waiting && i < workers.size(); ++i) {
+            if(fds[i].revents == 0) {
+                continue;
+            }
+            uint64_t unit;
+            uint64_t time;
+            std::string result;
+            if(!readFrame(workers[i].fromWorker, unit, time, result) || unit >= count) {
+                std::cerr << "ERROR: Worker " << workers[i].pid << " exited without finishing its unit." << std::endl;
+                ok = false;
+                break;
+            }
+            finished[unit].swap(result);
+            workers[i].busy = false;
+            workers[i].units++;
+            workers[i].busyTime += time;
+        }
+
+        // Write out whatever can now go out in order.
+        std::map<size_t, std::string>::iterator it;
+        while((it = finished.find(written)) != finished.end()) {
+            if(!reused[written]) {
+                job.completed(written, it->second);
+            }
+            sink.write(written, it->second);
+            finished.erase(it);
+            ++written;
+        }
+    }
+
+    uint64_t wallTime = microseconds() - startTime;
+    for(size_t i = 0; i < workers.size(); ++i) {
+        writeFrame(workers[i].toWorker, NO_MORE_UNITS, 0, std::string());
+        close(workers[i].toWorker);
+        close(workers[i].fromWorker);
+    }
+    for(size_t i = 0; i < workers.size(); ++i) {
+        int status;
+        while(waitpid(workers[i].pid, &status, 0) < 0 && errno == EINTR) {
+        }
+    }
+    signal(SIGPIPE, oldPipeHandler);
+    if(verbose) {
+        reportUtilization(workers, wallTime);
+    }
+    return ok;
+}
@@ -0,0 +1,57 @@
+#ifndef __WORKERPOOL_H__
+#define __WORKERPOOL_H__
+
+#include <string>
+#include <stdint.h>
+#include "outputSink.h"
+
+// The work done for each compilation unit.
+class UnitJob {
+    public:
+        virtual ~UnitJob() {};
+
+        // An estimate of how long the unit takes to convert, relative to
+        // the others; the DIE count or size in bytes will do.
+        virtual uint64_t cost(size_t unit) { return 0; };
+
+        // Called in the parent, in unit order, before the unit is handed
+        // out. Whatever it returns is passed on to run(). When the units
+        // are run in this process, prepare() runs on its own thread a few
+        // units ahead of run(), so it must not touch the ROSE IR.
+        virtual std::string prepare(size_t unit) { return std::string(); };
+
+        // Called in the parent right after prepare(). Returning true with
+        // output filled in means the unit's output is already known (say,
+        // from a cache) and run() is skipped for it.
+        virtual bool reuse(size_t unit, std::string & output) { return false; };
+
+        // Called in the parent with the output of every unit that was run,
+        // in unit order, possibly on a separate thread.
+        virtual void completed(size_t unit, const std::string & output) {};
+
+        // Converts one unit and returns its output.
+        virtual std::string run(size_t unit, const std::string & input) = 0;
+
+        // Called once by each process that ran units, after its last one.
+        virtual void finish() {};
+};
+
+namespace WorkerPool {
+    // Runs the job for units 0 to count - 1 on the given number of forked
+    // worker processes and passes the results to sink in unit order, so the
+    // output is the same as a sequential run. ROSE keeps its IR in
+    // process-wide memory pools, so separate processes rather than threads
+    // are what lets conversions run side by side. With one worker the job
+    // runs in this process, as a pipeline: one thread prepares units,
+    // the calling thread runs them, and another thread writes the
+    // results, each working on a different unit.
+    //
+    // Workers take one unit at a time, most costly first, so the largest
+    // units start right away and the small ones fill in around them. If
+    // verbose is set, how busy each worker or pipeline stage was is
+    // reported at the end.
+    // Returns false if a worker failed.
+    bool run(UnitJob & job, size_t count, unsigned workers, UnitSink & sink, bool verbose = false);
+}
+
+#endif